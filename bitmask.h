@@ -0,0 +1,164 @@
+#ifndef BITMASK_HPP
+#define BITMASK_HPP
+/* ============================================================================
+'bitmask.h' defines a packed array of bits, one per map pixel.  All methods
+are inline.
+============================================================================ */
+#include <vector>
+#include <algorithm>
+#include "pixel.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+/* ============================================================================
+The BitMask class stores one bit per pixel, 64 to a word.  Whole-map loops
+should use forRuns(), which scans a word at a time and hands back each run of
+set bits so that the inner loop over a run needs no test.
+============================================================================ */
+class BitMask
+{
+	protected:
+		std::vector<uint64_t> w_;	// The bits; bit i is bit (i % 64) of word i / 64
+		PixIndex n_;				// The number of bits
+
+		static int lowBit (uint64_t w);
+		PixIndex nextBit (PixIndex i, bool b) const;
+	public:
+		BitMask () : n_(0) {}
+
+		// Size.
+		PixIndex size () const { return n_; }
+		bool empty () const { return n_ == 0; }
+		void clear () { w_.clear(); n_ = 0; }
+		void resize (PixIndex n, bool b);
+		void swap (BitMask &m) { w_.swap(m.w_); std::swap(n_, m.n_); }
+
+		// Single bit access.
+		bool test (PixIndex i) const { return ((w_[i >> 6] >> (i & 63)) & 1) != 0; }
+		void set (PixIndex i, bool b = true);
+
+		// Whole mask queries.
+		PixIndex count () const;
+		bool all () const { return count() == n_; }
+
+		// Call f(begin, end) for each run of set bits, in all or part of the mask.
+		template <class F> void forRuns (F f) const { forRuns(0, n_, f); }
+		template <class F> void forRuns (PixIndex b, PixIndex e, F f) const;
+};
+/* ----------------------------------------------------------------------------
+'lowBit' returns the position of the lowest set bit of a nonzero word.
+
+Static function.
+
+Arguments:
+	w - The word.
+
+Returned:
+	The bit position, 0--63.
+---------------------------------------------------------------------------- */
+inline int BitMask::lowBit (uint64_t w)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward64(&i, w);
+	return int(i);
+#else
+	return __builtin_ctzll(w);
+#endif
+}
+/* ----------------------------------------------------------------------------
+'nextBit' finds the next bit with a given value.
+
+Arguments:
+	i - The position to start from.
+	b - The value sought.
+
+Returned:
+	The position of the bit, or size() if there is none.
+---------------------------------------------------------------------------- */
+inline PixIndex BitMask::nextBit (PixIndex i, bool b) const
+{
+	if (i >= n_) return n_;
+	const uint64_t flip = b ? 0 : ~uint64_t(0);
+	size_t   k = size_t(i >> 6);
+	uint64_t w = (w_[k] ^ flip) & (~uint64_t(0) << (i & 63));
+	while (w == 0)
+	{
+		if (++k >= w_.size()) return n_;
+		w = w_[k] ^ flip;
+	}
+	PixIndex j = PixIndex(k) * 64 + lowBit(w);
+	return (j < n_) ? j : n_;
+}
+/* ----------------------------------------------------------------------------
+'resize' sets the number of bits and gives all of them one value.
+
+Arguments:
+	n - The number of bits.
+	b - The value.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+inline void BitMask::resize (PixIndex n, bool b)
+{
+	n_ = n;
+	w_.assign(size_t((n + 63) / 64), b ? ~uint64_t(0) : 0);
+}
+/* ----------------------------------------------------------------------------
+'set' sets or clears one bit.
+
+Arguments:
+	i - The bit.
+	b - The value.  Defaults to true.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+inline void BitMask::set (PixIndex i, bool b)
+{
+	const uint64_t m = uint64_t(1) << (i & 63);
+	if (b) w_[i >> 6] |= m;
+	  else w_[i >> 6] &= ~m;
+}
+/* ----------------------------------------------------------------------------
+'count' returns the number of set bits.
+
+Arguments:
+	None.
+
+Returned:
+	The count.
+---------------------------------------------------------------------------- */
+inline PixIndex BitMask::count () const
+{
+	PixIndex c = 0;
+	forRuns([&c](PixIndex b, PixIndex e) { c += e - b; });
+	return c;
+}
+/* ----------------------------------------------------------------------------
+'forRuns' calls a function for each run of consecutive set bits among the
+bits first to last - 1.  Runs of clear or set bits are skipped a word at a
+time.
+
+Arguments:
+	first - The first bit to consider.
+	last  - One past the last bit to consider.
+	f     - The function, called as f(begin, end) for the bits begin to
+	        end - 1.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+template <class F> inline void BitMask::forRuns (PixIndex first, PixIndex last, F f) const
+{
+	if (last > n_) last = n_;
+	PixIndex b = nextBit(first, true);
+	while (b < last)
+	{
+		PixIndex e = std::min(nextBit(b, false), last);
+		f(b, e);
+		b = nextBit(e, true);
+	}
+}
+#endif
@@ -5,11 +5,13 @@ required by the application.
 Written by Nicholas Phillips.
 QT4 adaption and Black/White color table by Michael R. Greason, ADNET,
 	27 August 2007.
+Packed RGBA table for the texture kernel.
 ============================================================================ */
 /*
 			Fetch header files.
 */
 #include "colortable.h"
+#include <string.h>
 #include "define_colortable.h"
 
 using namespace std;
@@ -68,7 +70,8 @@ ColorTable::ColorTable(int id)
 }
 /* ----------------------------------------------------------------------------
 'define_table' performs the work in defining a color table from
-'define_colortable.h'.  This routine does NOT define the name of the table.
+'define_colortable.h', and resamples it into the packed table.  This routine
+does NOT define the name of the table.
 
 Arguments:
 	intab - The desired color table as a float array.
@@ -84,6 +87,30 @@ void ColorTable::define_table (float intab[][3])
 	table.resize(ncols);
 	for(uint i = 0; i < ncols; i++)
 		table[i].setRgbF(intab[i][0], intab[i][1], intab[i][2]);
+	packed.resize(packedSize);
+	for(uint i = 0; i < packedSize; i++)
+		packed[i] = pack(operator[](float(i) / (packedSize - 1)));
+}
+/* ----------------------------------------------------------------------------
+'pack' packs an opaque color into one word whose bytes are red, green, blue
+and alpha in memory order, whatever the byte order of the machine.
+
+Static function.
+
+Arguments:
+	col - The color.
+
+Returned:
+	The packed color.
+---------------------------------------------------------------------------- */
+uint32_t ColorTable::pack(const QColor &col)
+{
+	const unsigned char rgba[4] = {
+		(unsigned char) col.red(), (unsigned char) col.green(),
+		(unsigned char) col.blue(), 255 };
+	uint32_t w;
+	memcpy(&w, rgba, sizeof(w));
+	return w;
 }
 /* ----------------------------------------------------------------------------
 'operator[]' returns the indexed element in the table.
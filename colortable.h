@@ -7,6 +7,7 @@ required by the application.
 Written by Nicholas Phillips.
 QT4 adaption and Black/White color table by Michael R. Greason, ADNET,
 	27 August 2007.
+Packed RGBA table for the texture kernel.
 ============================================================================ */
 /*
 			Fetch header files.
@@ -15,6 +16,7 @@ QT4 adaption and Black/White color table by Michael R. Greason, ADNET,
 #include <QColor>
 #include <QPixmap>
 #include <vector>
+#include <stdint.h>
 /* ============================================================================
 'ColorTable' maintains a single color table.  Each element represents one
 usable color; it may be accessed either by indexing it directly or by supplying
@@ -23,6 +25,11 @@ a value from 0--1.
 The color tables currently supported are staticly defined in 
 'define_colortable.h'.
 
+For the texture kernel the table is also kept resampled to packedSize entries,
+a power of two, with each color packed into one 32-bit word whose bytes are
+red, green, blue and alpha in memory order, ready to be stored straight into
+an RGBA texture.
+
 TBD:
 	- Allow the setting of color tables from image files.
 	- Return a pixmap of the color table.
@@ -38,10 +45,14 @@ public:
 	int getSize (void) const;
 	QString getName() const;
 	QPixmap getPixmap();
+	const std::vector<uint32_t> &getPacked() const;
+	static uint32_t pack(const QColor &col);
+	static const unsigned int packedSize = 4096;	//!< Entries in the packed table
 protected:
 	QString name;			//!< Name of the table.
 	unsigned int ncols;		//!< Number of colors in this table
 	std::vector<QColor> table;	//!< The color table
+	std::vector<uint32_t> packed;	//!< The table resampled and packed as RGBA
 private:
 	void define_table (float intab[][3]);
 };
@@ -76,6 +87,20 @@ inline int ColorTable::getSize(void) const
 	return ncols;
 }
 /* ----------------------------------------------------------------------------
+'getPacked' returns the packed RGBA table.
+
+Arguments:
+	None.
+
+Returned:
+	The packedSize packed colors; entry i is the color of the value
+	i / (packedSize - 1).
+---------------------------------------------------------------------------- */
+inline const std::vector<uint32_t> &ColorTable::getPacked() const
+{
+	return packed;
+}
+/* ----------------------------------------------------------------------------
 'operator[]' returns the indexed element in the table.
 
 Arguments:
@@ -88,6 +88,15 @@ void ControlDialog::loadField(Field f)
 	mapstats.loadField(f);
 	return;
 }
+/* ------------------------------------------------------------------------------------
+'loadProgress' shows how much of the file has been read.
+------------------------------------------------------------------------------------*/
+void ControlDialog::loadProgress(qint64 done, qint64 total)
+{
+	int pct = (total > 0) ? int((100 * done) / total) : 0;
+	loading->setText(QString("Loading %1%").arg(pct));
+	return;
+}
 void ControlDialog::loadNSide(int ns, int ord)
 {
 	QString str;
@@ -124,7 +133,7 @@ void ControlDialog::init(Skymap *map)
 	return;
 }
 /* ------------------------------------------------------------------------------------*/
-bool ControlDialog::selectPixel(int i, BasePixel *pix)
+bool ControlDialog::selectPixel(PixIndex i, BasePixel *pix)
 {
 	bool set = selectedpixels(i,pix);
 	clearall->setEnabled(selectedpixels.rowCount() > 0);
@@ -140,7 +149,7 @@ void ControlDialog::on_clearsel_clicked()
 	QModelIndex index;
 
 	// build the list of skymap pixel numbers to clear
-	vector<int> clearpixs;
+	vector<PixIndex> clearpixs;
 	foreach(index, indexes) {
 		if( index.column() == 0 ) 
 			clearpixs.push_back(selectedpixels.pixnum(index.row()));
@@ -157,7 +166,7 @@ void ControlDialog::on_clearsel_clicked()
 /* ------------------------------------------------------------------------------------*/
 void ControlDialog::on_clearall_clicked()
 {
-	vector<int> clearpixs(selectedpixels.size());
+	vector<PixIndex> clearpixs(selectedpixels.size());
 	for(int i = 0; i < selectedpixels.size(); i++)
 		clearpixs[i] = selectedpixels.pixnum(i);
 	selectedpixels.clear();
@@ -185,6 +194,6 @@ void ControlDialog::updateClearSelection(const QItemSelection& /*selected*/, con
 void ControlDialog::doubleClicked(const QModelIndex & index )
 {
 	QModelIndex idx = selectedpixels.index(index.row(),0);
-	emit recenterOnPixel(selectedpixels.data(idx,Qt::DisplayRole).toInt());
+	emit recenterOnPixel(selectedpixels.data(idx,Qt::DisplayRole).toLongLong());
 	return;
 }
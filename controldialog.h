@@ -31,19 +31,20 @@ public:
 	void startFile(QString );
 	void hasField(Field, bool);
 	void loadField(Field);
+	void loadProgress(qint64 done, qint64 total);
 	void loadNSide(int nside, int ordering);
 	void finished(Skymap *);
 
 	// initialize and associate with a given sky map
 	void init(Skymap *map);
 
-	bool selectPixel(int i, BasePixel *pix);
-	int pixnum(int i);
+	bool selectPixel(PixIndex i, BasePixel *pix);
+	PixIndex pixnum(int i);
 	int numselected();
 
 signals:
-	void resetPixels(std::vector<int>);
-	void recenterOnPixel(int pixnum);
+	void resetPixels(std::vector<PixIndex>);
+	void recenterOnPixel(PixIndex pixnum);
 	
 private:
 	SelectedPixelModel selectedpixels;
@@ -67,7 +68,7 @@ inline int ControlDialog::numselected()
 	return selectedpixels.size();
 }
 
-inline int ControlDialog::pixnum(int i)
+inline PixIndex ControlDialog::pixnum(int i)
 {
 	return selectedpixels.pixnum(i);
 }
@@ -7,5 +7,7 @@ enum Projection { Spherical, Mollweide };
 enum Field { I, Q, U, P, Nobs };
 // displaying Polarization vector either on or off
 enum PolVectors { Off, On };
+// color stretches applied to the display range
+enum Stretch { Linear, Equalize, Log, Sqrt, Asinh };
 
 #endif
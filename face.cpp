@@ -3,11 +3,14 @@
 
 Written by Nicholas Phillips.
 QT4 adaption by Michael R. Greason, ADNET, 27 August 2007
+Drawing from a tiled texture.
 ============================================================================ */
 /*
 			Fetch header files.
 */
+#include <map>
 #include "face.h"
+#include "tiles.h"
 #include "debug.h"
 #include "boundary.h"
 #include "heal.h"
@@ -249,14 +252,15 @@ void Face::setRigging(const int nside, vector<double> &costhetas,
 'draw' paints the face.
 
 Arguments:
-	None.
+	tiles - The tiled texture to draw the face from, or NULL to draw it
+	        from the current texture.  Defaults to NULL.
 
 Returned:
 	Nothing.
 
 Written by Nicholas Phillips.
 ---------------------------------------------------------------------------- */
-void Face::draw()
+void Face::draw(TileBinder *tiles)
 {
 	if (! rigging_set) {
 		throw (MapException(MapException::Other, 0,
@@ -264,6 +268,10 @@ void Face::draw()
 	}
 	
 	if( showface6 && face != 6 ) return;
+	if( tiles != 0 && ! showrigging ) {
+		drawTiled(tiles);
+		return;
+	}
 	
 	QColor color;
 	GLVertVI qli = quadList.begin();
@@ -312,6 +320,85 @@ void Face::draw()
 	return;
 }
 /* ----------------------------------------------------------------------------
+'drawTiled' paints the face from a tiled texture.  The texture coordinates of
+the rigging place each vertex in the face; each quad of the rigging is cut
+along the tile edges into pieces, bilinearly, and the pieces are drawn tile
+by tile with coordinates within their tile.  The rigging and the tiles both
+split the face in powers of two, so a piece of a regular quad lies in one
+tile; the odd quads along the split of face 6 in the Mollweide projection
+are given the tile of their middle.  Tiles none of whose pieces face the
+viewer are skipped, so they are never colored or sent to GL.
+
+Arguments:
+	tiles - The tiled texture.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void Face::drawTiled(TileBinder *tiles)
+{
+	const int n = tiles->tilesPerSide();
+	if( n <= 0 ) return;
+	const double s0 = face % 4, t0 = face / 4;
+	typedef std::pair<int, int> Tile;
+	std::map<Tile, GLVertices> pieces;	// Four vertices a piece, by tile
+	for(GLVertVI qli = quadList.begin(); qli != quadList.end(); ++qli) {
+		for(size_t j = 0; j + 3 < qli->size(); j += 2) {
+			// Corners in order around the quad, and their extent in tiles.
+			const GLPoint *c[4] = { &(*qli)[j], &(*qli)[j+1], &(*qli)[j+3], &(*qli)[j+2] };
+			double fs[4], ft[4];
+			double smin = 1e9, smax = -1e9, tmin = 1e9, tmax = -1e9;
+			for(int k = 0; k < 4; k++) {
+				fs[k] = (4.*c[k]->s - s0) * n;
+				ft[k] = (4.*c[k]->t - t0) * n;
+				smin = std::min(smin, fs[k]);  smax = std::max(smax, fs[k]);
+				tmin = std::min(tmin, ft[k]);  tmax = std::max(tmax, ft[k]);
+			}
+			int m = 1;
+			while( m < 64 && ((smax - smin) > m + 1e-6 || (tmax - tmin) > m + 1e-6) ) m *= 2;
+			// Cut into m x m pieces.
+			for(int a = 0; a < m; a++) for(int b = 0; b < m; b++) {
+				const double u[4] = { double(a)/m, double(a+1)/m, double(a+1)/m, double(a)/m };
+				const double w[4] = { double(b)/m, double(b)/m, double(b+1)/m, double(b+1)/m };
+				GLPoint p[4];
+				double ps[4], pt[4], ms = 0., mt = 0.;
+				for(int k = 0; k < 4; k++) {
+					const double wt[4] = { (1-u[k])*(1-w[k]), u[k]*(1-w[k]), u[k]*w[k], (1-u[k])*w[k] };
+					double x = 0., y = 0., z = 0.;
+					ps[k] = pt[k] = 0.;
+					for(int i = 0; i < 4; i++) {
+						x += wt[i]*c[i]->x;  y += wt[i]*c[i]->y;  z += wt[i]*c[i]->z;
+						ps[k] += wt[i]*fs[i];  pt[k] += wt[i]*ft[i];
+					}
+					p[k].setVertC(x, y, z);
+					ms += 0.25*ps[k];
+					mt += 0.25*pt[k];
+				}
+				Tile tile(std::max(0, std::min(n-1, int(floor(ms)))),
+				          std::max(0, std::min(n-1, int(floor(mt)))));
+				GLVertices &v = pieces[tile];
+				for(int k = 0; k < 4; k++) {
+					p[k].setTex(std::max(0., std::min(1., ps[k] - tile.first)),
+					            std::max(0., std::min(1., pt[k] - tile.second)));
+					v.push_back(p[k]);
+				}
+			}
+		}
+	}
+	for(std::map<Tile, GLVertices>::iterator pi = pieces.begin(); pi != pieces.end(); ++pi) {
+		GLVertices &v = pi->second;
+		bool seen = false;
+		for(GLVertI pti = v.begin(); pti != v.end() && ! seen; ++pti)
+			seen = tiles->facing(pti->x, pti->y, pti->z);
+		if( ! seen || ! tiles->bindTile(face, pi->first.first, pi->first.second) ) continue;
+		glBegin(GL_QUADS);
+		for(GLVertI pti = v.begin(); pti != v.end(); ++pti)
+			pti->glSet();
+		glEnd();
+	}
+	return;
+}
+/* ----------------------------------------------------------------------------
 'toMollweide' computes the vertices assuming a Molleweide projection.  If
 the supplied radius is <1 then push the projection out of the screen so that
 it lies behind a projection with radius 1, when viewed from x < 0.
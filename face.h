@@ -10,6 +10,8 @@ QT4 adaption by Michael R. Greason, ADNET, 27 August 2007
 			Fetch header files.
 */
 #include "glpoint.h"
+
+class TileBinder;
 /* ============================================================================
 'Face' maintains the contents of one block of the sky.
 ============================================================================ */
@@ -23,6 +25,7 @@ protected:
 	void setRigging_NP(const int nside, std::vector<double> &costhetas, double rad = 1.);
 	void setRigging_EQ(const int nside, std::vector<double> &costhetas, double rad = 1.);
 	void setRigging_SP(const int nside, std::vector<double> &costhetas, double rad = 1.);
+	void drawTiled(TileBinder *tiles);
 public:
 	Face() : face(0), rigging_set(false) {};
 	virtual ~Face() {};
@@ -30,7 +33,7 @@ public:
 	void faceNumber(const int face_) { face = face_; }
 	void setRigging(const int nside, std::vector<double> &costhetas,
 		bool viewmoll, double rad = 1.);
-	void draw();
+	void draw(TileBinder *tiles = 0);
 	void toMollweide(double rad = 1.);
 	void toMollweideBackfaceSplit(void);
 };
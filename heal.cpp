@@ -111,6 +111,55 @@ long xy2pix(long ix, long iy)
 			+ (x2pix[ix_low]+y2pix[iy_low]);
 }
 /* ----------------------------------------------------------------------------
+'xyf2ring' converts a position within a base face into a RING pixel number,
+from the ring and the place in the ring of the pixel worked out directly, so
+that no per-pixel table or search is needed.
+
+Arguments:
+	nside - The map's nside.
+	ix,iy - The position within the face, each 0 to nside - 1, ix along the
+	        bits of a NESTED pixel number that 'xy2pix' takes from its first
+	        argument.
+	face  - The base face, 0--11.
+
+Returned:
+	pix   - The RING pixel number.
+---------------------------------------------------------------------------- */
+hpint64 xyf2ring(hpint64 nside, hpint64 ix, hpint64 iy, int face)
+{
+	static const int jrll[12] = { 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+	static const int jpll[12] = { 1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7 };
+	const hpint64 nl4 = 4 * nside;
+/*
+			The ring, counted from the north pole, and the
+			pixels before it.
+*/
+	hpint64 jr = jrll[face] * nside - ix - iy - 1;
+	hpint64 nr, n_before, kshift;
+	if( jr < nside ) {
+		nr = jr;
+		n_before = 2 * nr * (nr - 1);
+		kshift = 0;
+	}
+	else if( jr > 3 * nside ) {
+		nr = nl4 - jr;
+		n_before = 12 * nside * nside - 2 * (nr + 1) * nr;
+		kshift = 0;
+	}
+	else {
+		nr = nside;
+		n_before = 2 * nside * (nside - 1) + (jr - nside) * nl4;
+		kshift = (jr - nside) & 1;
+	}
+/*
+			The place in the ring, 1 to 4 nr.
+*/
+	hpint64 jp = (jpll[face] * nr + ix - iy + 1 + kshift) / 2;
+	if( jp > nl4 ) jp -= nl4;
+	else if( jp < 1 ) jp += nl4;
+	return n_before + jp - 1;
+}
+/* ----------------------------------------------------------------------------
 'toMollweide' converts phi/lambda into x/y and theta, implementing a conversion
 into the Molleweide projection.
 
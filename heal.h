@@ -9,6 +9,7 @@ extern "C"
 };
 
 long xy2pix(long ix, long iy);
+hpint64 xyf2ring(hpint64 nside, hpint64 ix, hpint64 iy, int face);
 double toMollweide(const double phi, const double lambda, double &x, double &y);
 double fromMollweide(const double x, const double y, double &phi, double &lambda);
 #endif
@@ -10,6 +10,7 @@ Written by Michael R. Greason, ADNET, 29 December 2006.
 			the Gnu C++ compiler wouldn't link these functions in correctly
 			without it.
 */
+#include <new>
 #include <string.h>
 #include <stdio.h>
 extern "C"
@@ -72,6 +73,7 @@ void HealpixMap::writeFITSPrimaryHeader (fitsfile* fptr)
 {
 	char         stmp[80], comm[80];
 	unsigned int itmp;
+	LONGLONG     ltmp;
 	int          status = 0;
 
 	if (ordering_ == Undefined) throw MapException(MapException::Undefined);
@@ -95,12 +97,12 @@ void HealpixMap::writeFITSPrimaryHeader (fitsfile* fptr)
 	fits_write_key(fptr, TUINT, "NSIDE", &itmp, comm, &status);
 
 	strcpy(comm, "First pixel index (0 based)");
-	itmp = 0;
-	fits_write_key(fptr, TUINT, "FIRSTPIX", &itmp, comm, &status);
+	ltmp = 0;
+	fits_write_key(fptr, TLONGLONG, "FIRSTPIX", &ltmp, comm, &status);
 
 	strcpy(comm, "Last pixel index (0 based)");
-	itmp = size() - 1;
-	fits_write_key(fptr, TUINT, "LASTPIX", &itmp, comm, &status);
+	ltmp = size() - 1;
+	fits_write_key(fptr, TLONGLONG, "LASTPIX", &ltmp, comm, &status);
 
 	return;
 }
@@ -119,9 +121,13 @@ Returned:
 ---------------------------------------------------------------------------- */
 void HealpixMap::readFITSExtensionHeader (fitsfile* fptr)
 {
-	char tmp[24], comm[80];
-	int  status = 0;
+	char         tmp[24], comm[80];
+	unsigned int ns;
+	int          status = 0;
 	Skymap::readFITSExtensionHeader(fptr);
+	if (fits_read_key(fptr, TUINT, "NSIDE", &ns, comm, &status) == 0)
+		npix_ = NSide2NPix(ns);
+	status = 0;
 	if (fits_read_keyword(fptr, "ORDERING", tmp, comm, &status) != 0)
 		return;
 	fits_str_cull(tmp);
@@ -145,6 +151,7 @@ void HealpixMap::writeFITSExtensionHeader (fitsfile* fptr)
 {
 	char         stmp[80], comm[80];
 	unsigned int itmp;
+	LONGLONG     ltmp;
 	int          status = 0;
 
 	Skymap::writeFITSExtensionHeader(fptr);
@@ -166,12 +173,12 @@ void HealpixMap::writeFITSExtensionHeader (fitsfile* fptr)
 	fits_write_key(fptr, TUINT, "NSIDE", &itmp, comm, &status);
 
 	strcpy(comm, "First pixel index (0 based)");
-	itmp = 0;
-	fits_write_key(fptr, TUINT, "FIRSTPIX", &itmp, comm, &status);
+	ltmp = 0;
+	fits_write_key(fptr, TLONGLONG, "FIRSTPIX", &ltmp, comm, &status);
 
 	strcpy(comm, "Last pixel index (0 based)");
-	itmp = size() - 1;
-	fits_write_key(fptr, TUINT, "LASTPIX", &itmp, comm, &status);
+	ltmp = size() - 1;
+	fits_write_key(fptr, TLONGLONG, "LASTPIX", &ltmp, comm, &status);
 
 	return;
 }
@@ -191,21 +198,22 @@ Arguments:
 Returned:
 	The converted pixel index.
 ---------------------------------------------------------------------------- */
-unsigned int HealpixMap::degrade_pixindex (unsigned int i, unsigned int nsi,
+PixIndex HealpixMap::degrade_pixindex (PixIndex i, unsigned int nsi,
 	unsigned int nso)
 {
-	long ti, tj;
-	double scl;
+	hpint64 ti, tj;
+	PixIndex scl;
 	if (ordering_ == Undefined) throw MapException(MapException::Undefined);
-	if (ordering_ == Ring) ::ring2nest(long(nsi), long(i), &ti);
-	                  else ti = long(i);
-	scl = double(nso) / double(nsi);
-	tj = long(double(ti) * scl * scl);
-	if (ordering_ == Ring) ::nest2ring(long(nso), tj, &tj);
-	return ((unsigned int) tj);
+	if (ordering_ == Ring) ::ring2nest64(hpint64(nsi), hpint64(i), &ti);
+	                  else ti = hpint64(i);
+	scl = PixIndex(nsi / nso);
+	tj = ti / (scl * scl);
+	if (ordering_ == Ring) ::nest2ring64(hpint64(nso), tj, &tj);
+	return PixIndex(tj);
 }
 /* ----------------------------------------------------------------------------
-'degrade_map' reduces the size of the map.
+'degrade_map' reduces the size of the map.  Only valid pixels are averaged; a
+new pixel with none is invalid.
 
 If an error occurs, a MapException will be thrown.
 
@@ -217,93 +225,69 @@ Returned:
 ---------------------------------------------------------------------------- */
 void HealpixMap::degrade_map (unsigned int ns) 
 {
-	BasePixel *arr;
-	unsigned int i, j;
-	unsigned int nnew = NSide2NPix(ns);
+	PixIndex     i;
+	PixIndex     nnew = NSide2NPix(ns);
 	unsigned int *cnt;
+	double       *acc[NumCols];
+	int c;
 /*
-			Allocate space for the new array.
+			Allocate space for the new map and the accumulators.
 */
-	switch (type())
+	if (type() == none) throw MapException(MapException::InvalidType);
+	Skymap arr(nnew, type(), precision(), storage());
+	for (c = 0; c < NumCols; c++)
 	{
-		case TPix:
-			arr = new TPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		case PPix:
-			arr = new TPPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		case TnobsPix:
-			arr = new TnobsPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		case TPnobsPix:
-			arr = new TPnobsPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		default:
-			throw MapException(MapException::InvalidType);
-			break;
+		acc[c] = 0;
+		if ((c > NobsCol) || (col_[c] == 0)) continue;
+		if ((acc[c] = new (nothrow) double[nnew]()) == NULL)
+			throw MapException(MapException::Memory);
 	}
-	if ((cnt = new unsigned int[nnew]) == NULL)
-		throw MapException(MapException::InvalidType);
-	for (i = 0; i < nnew; i++) cnt[i] = 0;
+	if ((cnt = new (nothrow) unsigned int[nnew]()) == NULL)
+		throw MapException(MapException::Memory);
 /*
 			Accumulate data into the new map.
 */
-	for (j = 0; j < size(); j++)
+	forValid([&](PixIndex b, PixIndex e)
 	{
-		i = degrade_pixindex(j, nside_, ns);
-		if (i >= nnew) break;
-		cnt[i] += 1;
-		try { arr[i].T()    += (*this)[j].T();    } catch (MapException &exc) { ; }
-		try { arr[i].Nobs() += (*this)[j].Nobs(); } catch (MapException &exc) { ; }
-		try { arr[i].Q()    += (*this)[j].Q();    } catch (MapException &exc) { ; }
-		try { arr[i].U()    += (*this)[j].U();    } catch (MapException &exc) { ; }
-	}
+		for (PixIndex j = b; j < e; j++)
+		{
+			PixIndex i = degrade_pixindex(j, nside_, ns);
+			if (i >= nnew) break;
+			cnt[i] += 1;
+			for (int c = TCol; c <= NobsCol; c++)
+			{
+				if (acc[c] != 0) acc[c][i] += value(Column(c), j);
+			}
+		}
+	});
 /*
-			Compute the mean temperature measurements.
+			Compute the mean temperature measurements.  N_obs stays summed.
 */
-	for (i = 0; i < nnew; i++)
+	for (c = TCol; c <= NobsCol; c++)
 	{
-		try { arr[i].T() /= double(cnt[i]); } catch (MapException &exc) { ; }
-		try { arr[i].Q() /= double(cnt[i]); } catch (MapException &exc) { ; }
-		try { arr[i].U() /= double(cnt[i]); } catch (MapException &exc) { ; }
+		if (acc[c] == 0) continue;
+		for (i = 0; i < nnew; i++)
+		{
+			if (cnt[i] == 0) continue;
+			arr.setValue(Column(c), i, (c == NobsCol) ? acc[c][i] : acc[c][i] / double(cnt[i]));
+		}
+		delete [] acc[c];
 	}
+	for (i = 0; i < nnew; i++)
+		if (cnt[i] == 0) arr.setValid(i, false);
+	delete [] cnt;
 /*
-			Destroy the old map array, assign the new one to the map,
-			and update bookkeeping parameters.
+			Take over the new map's storage and update bookkeeping parameters.
 */
-	delete [] cnt;
-	switch (type())
-	{
-		case TPix:
-			if (tpix != 0) delete [] tpix;
-			tpix = (TPixel*) arr;
-			break;
-		case PPix:
-			if (tppix != 0) delete [] tppix;
-			tppix = (TPPixel*) arr;
-			break;
-		case TnobsPix:
-			if (tnobspix != 0) delete [] tnobspix;
-			tnobspix = (TnobsPixel*) arr;
-			break;
-		case TPnobsPix:
-			if (tpnobspix != 0) delete [] tpnobspix;
-			tpnobspix = (TPnobsPixel*) arr;
-			break;
-		default:
-			throw MapException(MapException::InvalidType);
-			break;
-	}
+	swapColumns(arr);
 	nside_ = ns;
-	n_     = nnew;
+	computePolar();
 	return;
 }
 /* ----------------------------------------------------------------------------
-'upgrade_map' increases the size of the map.
+'upgrade_map' increases the size of the map.  The new pixels take the
+values and validity of the pixels they split, each found by degrading its
+own index.
 
 If an error occurs, a MapException will be thrown.
 
@@ -315,77 +299,32 @@ Returned:
 ---------------------------------------------------------------------------- */
 void HealpixMap::upgrade_map (unsigned int ns) 
 {
-	BasePixel *arr;
-	unsigned int i, j;
-	unsigned int nnew = NSide2NPix(ns);
-	double       scl;
+	PixIndex     i, j;
+	PixIndex     nnew = NSide2NPix(ns);
+	int          c;
 /*
-			Allocate space for the new array.
+			Allocate space for the new map.
 */
-	switch (type())
-	{
-		case TPix:
-			arr = new TPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		case PPix:
-			arr = new TPPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		case TnobsPix:
-			arr = new TnobsPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		case TPnobsPix:
-			arr = new TPnobsPixel[nnew];
-			if (arr == NULL) throw MapException(MapException::Memory);
-			break;
-		default:
-			throw MapException(MapException::InvalidType);
-			break;
-	}
+	if (type() == none) throw MapException(MapException::InvalidType);
+	Skymap arr(nnew, type(), precision(), storage());
 /*
-			Accumulate data into the new map.
+			Copy data into the new map.
 */
-	scl = double(nnew) / double(size());
 	for (j = 0; j < nnew; j++)
 	{
-		i = degrade_pixindex(j, ns, nside_);
-		i  = (unsigned int)(double(j) / scl);
+		i  = degrade_pixindex(j, ns, nside_);
 		if (i >= size()) break;
-		try { arr[j].T()	= (*this)[i].T();	 } catch (MapException &exc) { ; }
-		try { arr[j].Nobs() = (*this)[i].Nobs(); } catch (MapException &exc) { ; }
-		try { arr[j].Q()	= (*this)[i].Q();	 } catch (MapException &exc) { ; }
-		try { arr[j].U()	= (*this)[i].U();	 } catch (MapException &exc) { ; }
+		for (c = 0; c < NumCols; c++)
+		{
+			if (col_[c] != 0) arr.setValue(Column(c), j, value(Column(c), i));
+		}
+		if (! valid(i)) arr.setValid(j, false);
 	}
 /*
-			Destroy the old map array, assign the new one to the map,
-			and update bookkeeping parameters.
+			Take over the new map's storage and update bookkeeping parameters.
 */
-	switch (type())
-	{
-		case TPix:
-			if (tpix != 0) delete [] tpix;
-			tpix = (TPixel*) arr;
-			break;
-		case PPix:
-			if (tppix != 0) delete [] tppix;
-			tppix = (TPPixel*) arr;
-			break;
-		case TnobsPix:
-			if (tnobspix != 0) delete [] tnobspix;
-			tnobspix = (TnobsPixel*) arr;
-			break;
-		case TPnobsPix:
-			if (tpnobspix != 0) delete [] tpnobspix;
-			tpnobspix = (TPnobsPixel*) arr;
-			break;
-		default:
-			throw MapException(MapException::InvalidType);
-			break;
-	}
+	swapColumns(arr);
 	nside_ = ns;
-	n_     = nnew;
 	return;
 }
 /* ----------------------------------------------------------------------------
@@ -413,7 +352,7 @@ Arguments:
 Returned:
 	N/A.
 ---------------------------------------------------------------------------- */
-HealpixMap::HealpixMap (unsigned int n_in, Type type_in, PixOrder ord) : 
+HealpixMap::HealpixMap (PixIndex n_in, Type type_in, PixOrder ord) : 
 	Skymap(n_in, type_in)
 {
 	nside_    = NPix2NSide(n_in);
@@ -480,15 +419,15 @@ Arguments:
 Returned:
 	Nothing.
 ---------------------------------------------------------------------------- */
-void HealpixMap::pixel2vector (long pix, double *vector)
+void HealpixMap::pixel2vector (PixIndex pix, double *vector)
 {
 	switch (ordering_)
 	{
 		case Nested:
-			::pix2vec_nest(long(nside_), pix, vector);
+			::pix2vec_nest64(hpint64(nside_), pix, vector);
 			break;
 		case Ring:
-			::pix2vec_ring(long(nside_), pix, vector);
+			::pix2vec_ring64(hpint64(nside_), pix, vector);
 			break;
 		default:
 			throw MapException(MapException::Undefined);
@@ -509,16 +448,16 @@ Arguments:
 Returned:
 	Nothing.
 ---------------------------------------------------------------------------- */
-void HealpixMap::vector2pixel (double *vector, long &pix)
+void HealpixMap::vector2pixel (double *vector, PixIndex &pix)
 {
 	pix = 0;
 	switch (ordering_)
 	{
 		case Nested:
-			::vec2pix_nest(long(nside_), vector, &pix);
+			::vec2pix_nest64(hpint64(nside_), vector, &pix);
 			break;
 		case Ring:
-			::vec2pix_ring(long(nside_), vector, &pix);
+			::vec2pix_ring64(hpint64(nside_), vector, &pix);
 			break;
 		default:
 			throw MapException(MapException::Undefined);
@@ -544,16 +483,16 @@ Arguments:
 Returned:
 	Nothing.
 ---------------------------------------------------------------------------- */
-void HealpixMap::pixel2angles (long pix, double &theta, double &phi, int deg)
+void HealpixMap::pixel2angles (PixIndex pix, double &theta, double &phi, int deg)
 {
 	theta = phi = 0.0;
 	switch (ordering_)
 	{
 		case Nested:
-			::pix2ang_nest(long(nside_), pix, &theta, &phi);
+			::pix2ang_nest64(hpint64(nside_), pix, &theta, &phi);
 			break;
 		case Ring:
-			::pix2ang_ring(long(nside_), pix, &theta, &phi);
+			::pix2ang_ring64(hpint64(nside_), pix, &theta, &phi);
 			break;
 		default:
 			throw MapException(MapException::Undefined);
@@ -584,7 +523,7 @@ Arguments:
 Returned:
 	Nothing.
 ---------------------------------------------------------------------------- */
-void HealpixMap::angles2pixel (double theta, double phi, long &pix, int deg)
+void HealpixMap::angles2pixel (double theta, double phi, PixIndex &pix, int deg)
 {
 	pix = 0;
 	if (deg != 0)
@@ -595,10 +534,10 @@ void HealpixMap::angles2pixel (double theta, double phi, long &pix, int deg)
 	switch (ordering_)
 	{
 		case Nested:
-			::ang2pix_nest(long(nside_), theta, phi, &pix);
+			::ang2pix_nest64(hpint64(nside_), theta, phi, &pix);
 			break;
 		case Ring:
-			::ang2pix_ring(long(nside_), theta, phi, &pix);
+			::ang2pix_ring64(hpint64(nside_), theta, phi, &pix);
 			break;
 		default:
 			throw MapException(MapException::Undefined);
@@ -620,19 +559,19 @@ Arguments:
 Returned:
 	The converted pixel number.
 ---------------------------------------------------------------------------- */
-long HealpixMap::pix2ordering (long ipix, PixOrder dord)
+PixIndex HealpixMap::pix2ordering (PixIndex ipix, PixOrder dord)
 {
-	long opix = 0;
+	hpint64 opix = 0;
 	if ((dord == Undefined) || (ordering_ == Undefined))
 		throw MapException(MapException::Undefined);
 	if (dord == ordering_) return ipix;
 	switch (ordering_)
 	{
 		case Nested:
-			::nest2ring(long(nside_), ipix, &opix);
+			::nest2ring64(hpint64(nside_), ipix, &opix);
 			break;
 		case Ring:
-			::ring2nest(long(nside_), ipix, &opix);
+			::ring2nest64(hpint64(nside_), ipix, &opix);
 			break;
 		default:
 			throw MapException(MapException::Undefined);
@@ -655,8 +594,11 @@ void HealpixMap::resize (unsigned int ns)
 {
 	if (ordering_ == Undefined) throw MapException(MapException::Undefined);
 	if (ns == nside_) return;
+	bool wasSparse = sparse();
+	makeDense();
 	if (ns > nside_) upgrade_map(ns);
 	            else degrade_map(ns);
+	if (wasSparse) makeSparse();
 	return;
 }
 /* ----------------------------------------------------------------------------
@@ -677,7 +619,8 @@ Returned:
 'getPixel' retrieves a pixel based upon its position angles.
 
 If the pixel ordering of the map is undefined, then an Undefined MapException
-is thrown or if the resultant pixel number is out of bounds.
+is thrown or if the resultant pixel number is out of bounds or not stored
+in a sparse map.
 
 Arguments:
 	theta - The colatitude in radians measured southward from the north pole
@@ -690,17 +633,18 @@ Arguments:
 Returned:
 	The pixel is returned.
 ---------------------------------------------------------------------------- */
-BasePixel& HealpixMap::getPixel (double theta, double phi, int deg)
+MapPixel HealpixMap::getPixel (double theta, double phi, int deg)
 {
-	long pix;
+	PixIndex pix;
 	angles2pixel(theta, phi, pix, deg);
-	return (*this)[pix];
+	return (*this)[find(pix)];
 }
 /* ----------------------------------------------------------------------------
 'getPixel' retrieves a pixel based upon its cartesian pointing vector.
 
 If the pixel ordering of the map is undefined, then an Undefined MapException
-is thrown or if the resultant pixel number is out of bounds.
+is thrown or if the resultant pixel number is out of bounds or not stored
+in a sparse map.
 
 Arguments:
 	vector - The three-element cartesian pointing vector.
@@ -708,11 +652,11 @@ Arguments:
 Returned:
 	The pixel is returned.
 ---------------------------------------------------------------------------- */
-BasePixel& HealpixMap::getPixel (double *vector)
+MapPixel HealpixMap::getPixel (double *vector)
 {
-	long pix;
+	PixIndex pix;
 	vector2pixel(vector, pix);
-	return (*this)[pix];
+	return (*this)[find(pix)];
 }
 /* ----------------------------------------------------------------------------
 'readFITS' fills the map from a FITS file. An exception is thrown in the event
@@ -759,7 +703,7 @@ Returned:
 void HealpixMap::readFITS(const char* filename, ControlDialog *progwin)
 {
 	Skymap::readFITS(filename, progwin);
-	nside_ = NPix2NSide(size());
+	nside_ = NPix2NSide(npix());
 	if (progwin != NULL) progwin->loadNSide(nside_, ordering_);
 }
 void HealpixMap::readFITS(string filename, ControlDialog *progwin)
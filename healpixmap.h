@@ -23,12 +23,12 @@ class HealpixMap : public Skymap
 		};
 
 		// Healpix utilities.
-		static unsigned int NSide2NPix (unsigned int ns);
-		static unsigned int NPix2NSide (unsigned int np);
+		static PixIndex     NSide2NPix (unsigned int ns);
+		static unsigned int NPix2NSide (PixIndex np);
 		static unsigned int Res2NSide  (unsigned int res);
-		static unsigned int Res2NPix   (unsigned int res);
+		static PixIndex     Res2NPix   (unsigned int res);
 		static unsigned int NSide2Res  (unsigned int ns);
-		static unsigned int NPix2Res   (unsigned int np);
+		static unsigned int NPix2Res   (PixIndex np);
 	protected:
 		PixOrder     ordering_;		// Pixel ordering scheme.
 		unsigned int nside_;		// Map resolution parameter.
@@ -39,13 +39,13 @@ class HealpixMap : public Skymap
 		virtual void readFITSExtensionHeader  (fitsfile *fptr);
 		virtual void writeFITSExtensionHeader (fitsfile *fptr);
 
-		unsigned int degrade_pixindex (unsigned int i, unsigned int nsi, unsigned int nso);
+		PixIndex degrade_pixindex (PixIndex i, unsigned int nsi, unsigned int nso);
 		void degrade_map (unsigned int ns);
 		void upgrade_map (unsigned int ns);
 	public:
 		// Constructors and destructor.
 		HealpixMap ();
-		HealpixMap (unsigned int n_in, Type type_in, PixOrder ord = Undefined);
+		HealpixMap (PixIndex n_in, Type type_in, PixOrder ord = Undefined);
 		virtual ~HealpixMap();
 
 		void copy (HealpixMap &imap);
@@ -57,23 +57,23 @@ class HealpixMap : public Skymap
 		const char*  ordering   () const;
 		
 		// Pixel coordinate conversions.
-		void pixel2vector (long pix, double *vector);
-		void vector2pixel (double *vector, long &pix);
+		void pixel2vector (PixIndex pix, double *vector);
+		void vector2pixel (double *vector, PixIndex &pix);
 
-		void pixel2angles (long pix, double &theta, double &phi, int deg = 0);
-		void angles2pixel (double theta, double phi, long &pix, int deg = 0);
+		void pixel2angles (PixIndex pix, double &theta, double &phi, int deg = 0);
+		void angles2pixel (double theta, double phi, PixIndex &pix, int deg = 0);
 		
-		long pix2ordering (long ipix, PixOrder dord);
+		PixIndex pix2ordering (PixIndex ipix, PixOrder dord);
 
 		// Resize.
 		void resize (unsigned int ns);
-		
+
 		// Copy operator.
 		HealpixMap& operator= (HealpixMap &imap);
 
 		// Pixel access.
-		BasePixel& getPixel (double theta, double phi, int deg = 0);
-		BasePixel& getPixel (double *vector);
+		MapPixel getPixel (double theta, double phi, int deg = 0);
+		MapPixel getPixel (double *vector);
 
 		// FITS I/O.
 		/*
@@ -97,9 +97,9 @@ Arguments:
 Returned:
 	The number of pixels.
 ---------------------------------------------------------------------------- */
-inline unsigned int HealpixMap::NSide2NPix (unsigned int ns)
+inline PixIndex HealpixMap::NSide2NPix (unsigned int ns)
 {
-	return 12 * ns * ns;
+	return 12 * PixIndex(ns) * PixIndex(ns);
 }
 /* ----------------------------------------------------------------------------
 'NPix2NSide' computes the NSide parameter from a number of pixels.  It assumes
@@ -113,7 +113,7 @@ Arguments:
 Returned:
 	NSide.
 ---------------------------------------------------------------------------- */
-inline unsigned int HealpixMap::NPix2NSide (unsigned int np)
+inline unsigned int HealpixMap::NPix2NSide (PixIndex np)
 {
 	return (unsigned int) (sqrt(double(np) / 12.0) + 0.4);
 }
@@ -145,7 +145,7 @@ Arguments:
 Returned:
 	The number of pixels.
 ---------------------------------------------------------------------------- */
-inline unsigned int HealpixMap::Res2NPix (unsigned int res)
+inline PixIndex HealpixMap::Res2NPix (unsigned int res)
 {
 	return NSide2NPix(Res2NSide(res));
 }
@@ -175,7 +175,7 @@ Arguments:
 Returned:
 	The map resolution.
 ---------------------------------------------------------------------------- */
-inline unsigned int HealpixMap::NPix2Res (unsigned int np)
+inline unsigned int HealpixMap::NPix2Res (PixIndex np)
 {
 	return NSide2Res(NPix2NSide(np));
 }
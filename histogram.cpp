@@ -10,8 +10,10 @@
 //
 //
 #include <iomanip>
+#include <algorithm>
 #include <math.h>
 #include "histogram.h"
+#include "parallel.h"
 
 using namespace std;
 
@@ -47,8 +49,132 @@ void Histogram::setup(vector<float> &x)
 	return;
 } 
 /* ------------------------------------------------------------------------------------
+'setup' 
+	Take the stats of a map column, as computed and cached by the map.
+	The standard deviation is that of the population, as above.
+	
+Arguments:
+	s: the column stats
+Returned:
+	Nothing
+------------------------------------------------------------------------------------ */
+void Histogram::setup(const Skymap::Stats &s)
+{
+	minv = s.mn;
+	maxv = s.mx;
+	amaxv = s.amax();
+	meanv = s.mean;
+	stddevv = s.stddev(false);
+
+	return;
+} 
+/* ------------------------------------------------------------------------------------
+'binValues' 
+	Add a range of values to the finest bins of the pyramid. The bin
+	indices are computed a block at a time into a small array, in a loop
+	without branches that the compiler can vectorize; values out of range
+	go to an extra bin at the end, which is discarded. The increments then
+	follow. Every stride'th value in range is also added to the sample,
+	scaled to [0,1).
+	
+Arguments:
+	v:	the values
+	first:	the first value to bin
+	last:	one past the last value to bin
+	bins:	the nfine+1 bins, 64-bit as one bin of a large map can pass 2^31
+	nfine:	the number of bins in range
+	minr:	The bottom value for  the histogram
+	scale:	bins per unit value
+	stride:	the spacing of the sampled values
+	smp:	the sample
+Returned:
+	Nothing
+------------------------------------------------------------------------------------ */
+template <class T>
+static void binValues(const T *v, PixIndex first, PixIndex last, int64_t *bins, long nfine,
+	const float minr, const double scale, PixIndex stride, vector<float> &smp)
+{
+	const int blocksize = 256;
+	int idx[blocksize];
+	const double top = double(nfine);
+	for(PixIndex i = first; i < last; i += blocksize) {
+		int n = int(min(PixIndex(blocksize), last-i));
+		const T *x = v + i;
+		for(int k = 0; k < n; k++) {
+			// Truncation toward zero keeps values just below minr in bin 0.
+			double f = scale*(double(x[k])-minr);
+			idx[k] = (f > -1.0 && f < top) ? int(f) : int(nfine);
+		}
+		for(int k = 0; k < n; k++)
+			bins[idx[k]]++;
+	}
+	for(PixIndex i = (first+stride-1)/stride*stride; i < last; i += stride) {
+		double f = scale*(double(v[i])-minr);
+		if( (f >= 0) && (f < top) ) smp.push_back(float(f/top));
+	}
+}
+/* ------------------------------------------------------------------------------------
+'binThreads' 
+	Compute the bin pyramid with the values split among threads. Each
+	thread counts into its own finest bins and keeps its own sample; the
+	bins are summed and the samples joined and sorted at the end, so
+	nothing is shared while counting. Each coarser level then sums pairs
+	of bins of the level below, and the largest bin of each is found.
+	
+Arguments:
+	n:	the number of values
+	minr:	The bottom value for  the histogram
+	maxr:	The top value for  the histogram
+	f:	the function that bins the values first to last-1 into the
+		thread's bins and sample, called as
+		f(first, last, bins, nfine, scale, stride, sample)
+Returned:
+	Nothing
+------------------------------------------------------------------------------------ */
+template <class F>
+void Histogram::binThreads(PixIndex n, const float minr, const float maxr, F f)
+{
+	const long nfine = nbin << (nlevel-1);
+	const long nb = nfine+1;
+	const double scale = nfine/(double(maxr)-minr);
+	const PixIndex stride = (n > nsample) ? n/nsample : 1;
+	const unsigned int nth = parallelThreads();
+	vector<int64_t> part(size_t(nth)*nb, 0);
+	vector< vector<float> > smp(nth);
+	unsigned int nt = parallelFor(n, 65536,
+		[&](unsigned int t, PixIndex first, PixIndex last) {
+			f(first, last, &part[size_t(t)*nb], nfine, scale, stride, smp[t]);
+		});
+
+	h.assign(nlevel, vector<int64_t>());
+	hmax.assign(nlevel, 0);
+	h[0].assign(nfine, 0);
+	sample.clear();
+	for(unsigned int t = 0; t < nt; t++) {
+		for(long i = 0; i < nfine; i++)
+			h[0][i] += part[size_t(t)*nb + i];
+		sample.insert(sample.end(), smp[t].begin(), smp[t].end());
+	}
+	sort(sample.begin(), sample.end());
+
+	cum.resize(nfine+1);
+	cum[0] = 0;
+	for(long i = 0; i < nfine; i++)
+		cum[i+1] = cum[i] + h[0][i];
+	nin = cum[nfine];
+	for(int l = 0; l < nlevel; l++) {
+		if( l > 0 ) {
+			const vector<int64_t> &below = h[l-1];
+			h[l].resize(below.size()/2);
+			for(size_t i = 0; i < h[l].size(); i++)
+				h[l][i] = below[2*i] + below[2*i+1];
+		}
+		hmax[l] = *max_element(h[l].begin(), h[l].end());
+	}
+}
+/* ------------------------------------------------------------------------------------
 'set' 
-	Using a fixed bin count, compute the histogram
+	Using a fixed bin count, compute the histogram pyramid, in parallel
 	
 Arguments:
 	x: 	the vector of values to histogram
@@ -62,15 +188,50 @@ Written by Nicholas Phillips, UMCP, 6 August 2008.
 void Histogram::build(vector<float> &x, const float minr, const float maxr)
 {
 	nbin=2048;
-	h.clear();
-	h.resize(nbin);
-	long n = x.size();
-	hmax=0;
-	for(long i = 0; i < n; i++) {
-		long bin = (long)(nbin*(x[i]-minr)/(maxr-minr));
-		if( (bin < 0) || (bin >= nbin) ) continue; // out of range
-		h[bin]++;
-		if( h[bin] > hmax ) hmax = h[bin];
+	const float *v = x.data();
+	binThreads(PixIndex(x.size()), minr, maxr,
+		[&](PixIndex first, PixIndex last, int64_t *bins, long nfine, double scale,
+		    PixIndex stride, vector<float> &smp) {
+			binValues(v, first, last, bins, nfine, minr, scale, stride, smp);
+		});
+
+	return;
+} 
+/* ------------------------------------------------------------------------------------
+'build' 
+	Using a fixed bin count, compute the histogram pyramid of the valid
+	values of a map column, reading the column in place, in parallel.
+	
+Arguments:
+	map:	the map
+	col:	the column to histogram
+	minr:	The bottom value for  the histogram
+	maxr:	The top value for  the histogram
+Returned:
+	Nothing
+------------------------------------------------------------------------------------ */
+void Histogram::build(const Skymap *map, Skymap::Column col, const float minr, const float maxr)
+{
+	nbin=2048;
+	if( map->precision() == Skymap::Single ) {
+		const float *v = map->column<float>(col);
+		binThreads(map->size(), minr, maxr,
+			[&](PixIndex first, PixIndex last, int64_t *bins, long nfine, double scale,
+			    PixIndex stride, vector<float> &smp) {
+				map->forValid(first, last, [&](PixIndex b, PixIndex e) {
+					binValues(v, b, e, bins, nfine, minr, scale, stride, smp);
+				});
+			});
+	}
+	else {
+		const double *v = map->column<double>(col);
+		binThreads(map->size(), minr, maxr,
+			[&](PixIndex first, PixIndex last, int64_t *bins, long nfine, double scale,
+			    PixIndex stride, vector<float> &smp) {
+				map->forValid(first, last, [&](PixIndex b, PixIndex e) {
+					binValues(v, b, e, bins, nfine, minr, scale, stride, smp);
+				});
+			});
 	}
 
 	return;
@@ -89,13 +250,17 @@ Written by Nicholas Phillips, UMCP, 6 August 2008.
 float Histogram::operator()(const float x) const
 {
 	long bin = (long)(nbin*x);
-	if( (bin < 0) || (bin >= nbin) )
+	if( (bin < 0) || (bin >= nbin) || (hmax[nlevel-1] <= 0) )
 		return 0;
-	return ((float)h[bin])/hmax;
+	return ((float)h[nlevel-1][bin])/hmax[nlevel-1];
 }
 
 /* ------------------------------------------------------------------------------------
 'operator()' 
+	The coarsest level of the pyramid whose bins are no wider than the
+	request range is used, so a zoomed view still spans many bins. A
+	range narrower than the finest bins is estimated from the sorted
+	sample instead, relative to the peak of the finest level.
 	
 Arguments:
 	x0: Lower limit of bin request range
@@ -109,17 +274,56 @@ Written by Nicholas Phillips, UMCP, 6 August 2008.
 ------------------------------------------------------------------------------------ */
 float Histogram::operator()(const float x0, const float x1) const
 {
-	long bin0 = (long)(nbin*x0);
-	long bin1 = (long)(nbin*x1);
+	if( (x0 < 0) || (x1 >= 1) )
+		return 0;
+
+	const long nfine = nbin << (nlevel-1);
+	const float width = x1-x0;
+	if( (width*nfine < 1) && ! sample.empty() && (hmax[0] > 0) ) {
+		long cnt = upper_bound(sample.begin(), sample.end(), x1)
+		         - lower_bound(sample.begin(), sample.end(), x0);
+		float y = (float(cnt)/sample.size()) * nin / (width*nfine);
+		return y < hmax[0] ? y/hmax[0] : 1;
+	}
+
+	int l = nlevel-1;
+	while( (l > 0) && (width*(nbin << (nlevel-1-l)) < 1) ) l--;
+	const long nb = nbin << (nlevel-1-l);
+	long bin0 = (long)(nb*x0);
+	long bin1 = (long)(nb*x1);
 
-	if( (bin0 < 0) || (bin1 >= nbin) )
+	if( (bin0 < 0) || (bin1 >= nb) )
 		return 0;
 
-	if( bin0 == bin1 ) return ((float)h[bin0])/hmax;
+	const vector<int64_t> &hl = h[l];
+	if( hmax[l] <= 0 ) return 0;
+	if( bin0 == bin1 ) return ((float)hl[bin0])/hmax[l];
 
 	float y = 0;
 	for(long i = bin0; i <= bin1; i++)
-		y += h[i];
+		y += hl[i];
 	y /= bin1-bin0+1;
-	return y/hmax;
+	return y/hmax[l];
+}
+/* ------------------------------------------------------------------------------------
+'fraction' 
+	The cumulative distribution of the binned values, from the finest
+	level of the pyramid, interpolating linearly within a bin. Used for
+	histogram equalization.
+	
+Arguments:
+	x: position along the histogram, 0 to 1
+Returned:
+	fraction of the values in range that lie below x, 0 to 1
+------------------------------------------------------------------------------------ */
+double Histogram::fraction(const float x) const
+{
+	const long nfine = nbin << (nlevel-1);
+	if( nin <= 0 ) return 0;
+	if( x <= 0 ) return 0;
+	if( x >= 1 ) return 1;
+	double f = x*nfine;
+	long bin = (long)f;
+	if( bin >= nfine ) bin = nfine-1;
+	return (cum[bin] + (f-bin)*h[0][bin])/nin;
 }
@@ -11,6 +11,8 @@
 #define HISTOGRAM_H
 
 #include <vector>
+#include <stdint.h>
+#include "skymap.h"
 
 /*
 	Used for computing and storing histogram data.
@@ -21,7 +23,15 @@
 	is between 0 and 1. Use the operator()
 	methods.
 
+	The histogram is kept as a pyramid: the finest level has 64
+	times the bins of the coarsest (2048), and each level between
+	halves the bins of the one below. A sorted sample of the values
+	covers ranges narrower than the finest bins. A zoomed view thus
+	keeps its resolution without rescanning the data.
+
 	Also can provide stats on the underlying data that was binned.
+	For a map column these come from the map's statistics cache, and
+	the column is binned in place rather than copied.
 
 	@author Nicholas Phillips <Nicholas.G.Phillips@nasa.gov>
 */
@@ -30,8 +40,12 @@ class Histogram
 public:
 	// Compute stats
 	void setup(std::vector<float> &x);
+	// Take the stats of a map column
+	void setup(const Skymap::Stats &s);
 	// Compute the histogram
 	void build(std::vector<float> &, const float, const float );
+	// Compute the histogram of the valid values of a map column
+	void build(const Skymap *map, Skymap::Column col, const float, const float );
 
 	// return some pre-computed stats
 	float min()	const	{ return minv; };
@@ -44,10 +58,21 @@ public:
 	// Access the histogram
 	float operator()(const float x) const;
 	float operator()(const float x0,const float x1) const;
+	// Fraction of the values in range that lie below x
+	double fraction(const float x) const;
 protected:
-	std::vector<int> h;	// The stored histogram
-	long nbin;		// Number of bins
-	int hmax;		// Largest bin value
+	// Bin values in parallel, merging per-thread bins
+	template <class F> void binThreads(PixIndex n, const float minr, const float maxr, F f);
+
+	static const int nlevel = 7;		// Levels in the bin pyramid
+	static const PixIndex nsample = 1 << 18;	// Target size of the sample
+
+	std::vector< std::vector<int64_t> > h;	// The bin pyramid, finest level first
+	std::vector<int64_t> hmax;	// Largest bin value of each level
+	std::vector<float> sample;	// Sorted sample of values in range, scaled to [0,1)
+	std::vector<int64_t> cum;	// Values in range below each finest bin edge
+	long nbin;		// Number of bins in the coarsest level
+	int64_t nin;		// Number of values in range
 	//float minr;		// Bottom of histogram range
 	//float maxr;		// Top of histogram range
 	float minv;		// Smallest value in the input vector
@@ -15,6 +15,20 @@
 
 using namespace std;
 
+/*
+	Percentile range presets offered in the zoom ComboBox. Unlike the
+	std dev presets they ignore a few very bright or faint pixels, so
+	they suit maps with point sources or galactic emission.
+*/
+static const struct {
+	const char *name;
+	double lo, hi;
+} percentilePresets[] = {
+	{ "1-99%",     0.01,  0.99  },
+	{ "0.1-99.9%", 0.001, 0.999 }
+};
+static const int numPercentilePresets = sizeof(percentilePresets)/sizeof(percentilePresets[0]);
+
 /* ------------------------------------------------------------------------------------
 'HistogramWidget' constructor
 
@@ -22,7 +36,8 @@ using namespace std;
 
 Written by Nicholas Phillips, UMCP, 6 August 2008.
 ------------------------------------------------------------------------------------ */
-HistogramWidget::HistogramWidget(QWidget *parent) : QWidget(parent), minz(0.0001)
+HistogramWidget::HistogramWidget(QWidget *parent) : QWidget(parent), minz(0.0001),
+	pctmap(NULL), pctcol(Skymap::TCol), pctgen(0)
 {
 
 	setupUi(this);
@@ -59,6 +74,9 @@ void HistogramWidget::set(vector<float> &x)
 	old_z = z = 1;
 	
 	histogram.setup(x);
+	cpct.clear();
+	zpct.clear();
+	pctmap = NULL;
 
 	minr = histogram.min();
 	maxr = histogram.max();
@@ -71,24 +89,24 @@ void HistogramWidget::set(vector<float> &x)
 	return;
 }
 	
-//void HistogramWidget::set(const HealpixMap *map, Field fld)
-void HistogramWidget::set(Skymap *map, Field fld)
+/* ------------------------------------------------------------------------------------
+'set' 
+	Setup the histoView and sliders for a field of a map. Only the valid
+	pixels are histogrammed. The stats come from the map's cache, so
+	switching back to a field costs only the binning. The percentile
+	presets are not found until one is picked, and are then kept until
+	the field or the map's data change.
+Arguments:
+	map	The map
+	fld	The field to select a range for
+Returned:
+	Nothing
+------------------------------------------------------------------------------------ */
+void HistogramWidget::set(const Skymap *map, Field fld)
 {
-	vector<float> x(map->n());
-	switch( fld ) {
-		case I: for(uint i = 0; i < map->n(); i++) x[i]= (*map)[i].T();
-			break;
-		case Q: for(uint i = 0; i < map->n(); i++) x[i]= (*map)[i].Q();
-			break;
-		case U: for(uint i = 0; i < map->n(); i++) x[i]= (*map)[i].U();
-			break;
-		case P: for(uint i = 0; i < map->n(); i++) x[i]= (*map)[i].Pmag();
-			break;
-		case Nobs: for(uint i = 0; i < map->n(); i++) x[i]= (*map)[i].Nobs();
-			break;
-	}
+	Skymap::Column col = Skymap::fieldColumn(fld);
 	
-	histogram.setup(x);
+	histogram.setup(map->stats(col));
 
 	switch( fld ) {
 		case I:
@@ -104,7 +122,14 @@ void HistogramWidget::set(Skymap *map, Field fld)
 			break;
 	}
 	
-	histogram.build(x, minr, maxr);
+	if( (map != pctmap) || (col != pctcol) || (map->generation() != pctgen) ) {
+		cpct.clear();
+		zpct.clear();
+	}
+	pctmap = map;
+	pctcol = col;
+
+	histogram.build(map, col, minr, maxr);
 	histoView->set(&histogram);
 	
 	setComboBoxes();
@@ -117,6 +142,41 @@ void HistogramWidget::set(ColorTable *ct)
 	histoView->set(ct);
 }
 /* ------------------------------------------------------------------------------------
+'findPercentiles' 
+	Find the center and zoom of each percentile range preset, unless they
+	are already known for the current data. They take one or two passes
+	over the column, so this is only done when a preset is picked. They
+	are exact unless the map is kept in scratch files, where a single
+	streaming pass is used instead.
+Arguments:
+	None
+Returned:
+	true if the presets are known, false if there is no map to find them in
+------------------------------------------------------------------------------------ */
+bool HistogramWidget::findPercentiles()
+{
+	if( pctmap == NULL ) return false;
+	if( ! cpct.empty() && (pctgen == pctmap->generation()) ) return true;
+
+	double q[2*numPercentilePresets], v[2*numPercentilePresets];
+	for(int i = 0; i < numPercentilePresets; i++) {
+		q[2*i]   = percentilePresets[i].lo;
+		q[2*i+1] = percentilePresets[i].hi;
+	}
+	pctmap->quantiles(pctcol, 2*numPercentilePresets, q, v,
+	                  pctmap->storage() != Skymap::Scratch);
+	cpct.resize(numPercentilePresets);
+	zpct.resize(numPercentilePresets);
+	for(int i = 0; i < numPercentilePresets; i++) {
+		float lo = (v[2*i]-minr)/(maxr-minr);
+		float hi = (v[2*i+1]-minr)/(maxr-minr);
+		cpct[i] = (lo+hi)/2;
+		zpct[i] = hi-lo > minz ? hi-lo : minz;
+	}
+	pctgen = pctmap->generation();
+	return true;
+}
+/* ------------------------------------------------------------------------------------
 'setComboBoxes' 
 	Set the fields for the Preset combo boxes based on the
 	current min and max ranges
@@ -144,6 +204,10 @@ void HistogramWidget::setComboBoxes()
 		zoomComboBox->addItem("2x Std Dev");
 	if( 3*zstddev < 1 )
 		zoomComboBox->addItem("3x Std Dev");
+	if( pctmap != NULL )
+		for(int i = 0; i < numPercentilePresets; i++)
+			if( zpct.empty() || (zpct[i] < 1) )
+				zoomComboBox->addItem(percentilePresets[i].name);
 	zoomComboBox->addItem("Full");
 
 	return;
@@ -341,6 +405,15 @@ void HistogramWidget::on_zoomComboBox_activated(int /*index*/)
 		old_c = c = 0.5;
 		changed = true;
 	}
+	else {
+		for(int i = 0; i < numPercentilePresets; i++)
+			if( (zoomComboBox->currentText() == percentilePresets[i].name)
+			    && findPercentiles() ) {
+				old_z = z = zpct[i];
+				old_c = c = cpct[i];
+				changed = true;
+			}
+	}
 	if( changed ) {
 		if( c+z/2 > 1 ) c =  1-z/2;
 		if( c-z/2 < 0 ) c = z/2;
@@ -63,9 +63,13 @@ public:
 	// setup for the passed data
 	void set(std::vector<float> &x);
 	// Set based on a selected field of an Healpix Map
-	void set(Skymap *map, Field fld);
+	void set(const Skymap *map, Field fld);
 	void set(ColorTable *);
 
+	// The histogram, and the position (0 to 1) of a value along it
+	const Histogram *getHistogram() const { return &histogram; }
+	float position(float v) const { return (v-minr)/(maxr-minr); }
+
 signals:
 	void newCenterZoom(float, float);
 	void newRange(float, float);
@@ -87,6 +91,11 @@ private:
 	float maxr;		// Max of range
 	float cmean;		// center for the data's mean
 	float zstddev;		// zoom for the data's std dev
+	std::vector<float> cpct;	// center for each percentile range preset
+	std::vector<float> zpct;	// zoom for each percentile range preset
+	const Skymap *pctmap;	// Map the percentile presets come from; NULL if none
+	Skymap::Column pctcol;	// Its column
+	uint64_t pctgen;	// The map's generation() when the presets were found
 	
 
 	QTimer *cztimer;	// Timer for sampling the center/zoom sliders
@@ -95,6 +104,7 @@ private:
 private:
 	void setComboBoxes();
 	void setNewRange();
+	bool findPercentiles();
 
 private slots:
 	void on_zoomSlider_sliderPressed();
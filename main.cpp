@@ -1,3 +1,4 @@
+#include <string.h>
 #include <qapplication.h>
 #include "mainwindow.h"
 /* ------------------------------------------------------------------------------------
@@ -13,6 +14,21 @@ int main( int argc, char ** argv )
 	w->show();
 	app.connect( &app, &QApplication::lastWindowClosed,
 	             &app, &QApplication::quit);
-	if (argc > 1) w->readFile(argv[argc-1]);
+/*
+			Options: -single/-double select the map storage precision; -mmap
+			keeps the maps in memory-mapped scratch files; -sparse stores
+			only the observed pixels of cut-sky maps; -indexed/-indexed16
+			keep the texture as 8- or 16-bit palette indices.
+*/
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-single") == 0) w->setPrecision(Skymap::Single);
+		if (strcmp(argv[i], "-double") == 0) w->setPrecision(Skymap::Double);
+		if (strcmp(argv[i], "-mmap")   == 0) w->setStorage(Skymap::Scratch);
+		if (strcmp(argv[i], "-sparse") == 0) w->setSparse(true);
+		if (strcmp(argv[i], "-indexed")   == 0) w->setIndexedTexture(8);
+		if (strcmp(argv[i], "-indexed16") == 0) w->setIndexedTexture(16);
+	}
+	if ((argc > 1) && (argv[argc-1][0] != '-')) w->readFile(argv[argc-1]);
 	return app.exec();
 }
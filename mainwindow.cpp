@@ -16,14 +16,11 @@ QT4 implementation.  Michael R. Greason, ADNET, 23 August 2007.
 #include "mainwindow.h"
 #include "controldialog.h"
 #include "rangecontrol.h"
+#include "maploader.h"
 #include "debug.h"
 #include "outlog.h"
 
 using namespace std;
-/*
-			Constants.
-*/
-const double WhiteRiggingRadius = 0.99;
 /* ====================================================================================
 'mainWindow' defines the main window.  It descends from QMainWindow and from the 
 Ui::MainWindow class that was created by QT Designer.
@@ -47,9 +44,13 @@ mainWindow::mainWindow(QWidget *parent) : QMainWindow(parent)
 			Initialize components.
 */
 	map         = NULL;
+	loader      = NULL;
+	precision   = Skymap::Single;
+	storage     = Skymap::Heap;
+	sparse      = false;
 	texture     = new SkyTexture;
 	rigging     = new Rigging;
-	whiterig    = new Rigging;
+	overlay     = new SelectionOverlay;
 	polarsphere = new PolarArgLineSet;
 /*
 			Populate the window.
@@ -61,7 +62,7 @@ mainWindow::mainWindow(QWidget *parent) : QMainWindow(parent)
 	viewer->setGeometry(QRect(1, 0, 600, 591));
 	viewer->setTexture(texture);
 	viewer->setRigging(rigging);
-	viewer->setWhiteRigging(whiterig);
+	viewer->setOverlay(overlay);
 	viewer->setPolarAngles(polarsphere);
 	viewer->setFPSIsDisplayed(false);
 
@@ -129,8 +130,8 @@ mainWindow::mainWindow(QWidget *parent) : QMainWindow(parent)
 	connect(rngctl,	static_cast<void(RangeControl::*)()>(&RangeControl::changeFieldInfo),	this, 	static_cast<void(mainWindow::*)()>(&mainWindow::newField));
 	connect(rngctl,	static_cast<void(RangeControl::*)()>(&RangeControl::changePolVect),	this, 	static_cast<void(mainWindow::*)()>(&mainWindow::newPolVect));
 
-	connect(ctl, static_cast<void(ControlDialog::*)(std::vector<int>)>(&ControlDialog::resetPixels), this, static_cast<void(mainWindow::*)(std::vector<int>)>(&mainWindow::unselectPixels));
-	connect(ctl, static_cast<void(ControlDialog::*)(int)>(&ControlDialog::recenterOnPixel),          this, static_cast<void(mainWindow::*)(int)>(&mainWindow::recenterOnPixel));
+	connect(ctl, static_cast<void(ControlDialog::*)(std::vector<PixIndex>)>(&ControlDialog::resetPixels), this, static_cast<void(mainWindow::*)(std::vector<PixIndex>)>(&mainWindow::unselectPixels));
+	connect(ctl, static_cast<void(ControlDialog::*)(PixIndex)>(&ControlDialog::recenterOnPixel),     this, static_cast<void(mainWindow::*)(PixIndex)>(&mainWindow::recenterOnPixel));
 /*
 			Remaining initialization.
 */
@@ -144,7 +145,6 @@ mainWindow::mainWindow(QWidget *parent) : QMainWindow(parent)
 	actionMollweide_m->setChecked(viewmoll);
 
 	rigging->generate (rngctl->getRigging(), viewmoll);
-	whiterig->generate(rngctl->getRigging(), viewmoll, WhiteRiggingRadius);
 	ctl->clearStatus();
 	ctl->show();
 	
@@ -159,14 +159,16 @@ Written by Michael R. Greason, ADNET, 23 August 2007.
 ------------------------------------------------------------------------------------ */
 mainWindow::~mainWindow(void)
 {
+	if (loader != NULL) delete loader;
+	loader = NULL;
 	if (map != NULL) delete map;
 	map = NULL;
 	if (texture != NULL) delete texture;
 	texture = NULL;
 	if (rigging != NULL) delete rigging;
 	rigging = NULL;
-	if (whiterig != NULL) delete whiterig;
-	whiterig = NULL;
+	if (overlay != NULL) delete overlay;
+	overlay = NULL;
 	if (polarsphere != NULL) delete polarsphere;
 	polarsphere = NULL;
 }
@@ -228,7 +230,10 @@ void mainWindow::readFile (const QString file)
 }
 /* ------------------------------------------------------------------------------------
 'readFile' reads a FITS file.  The name of the file is supplied through the internal
-filename variable.  This routine actually goes out and reads the file.
+filename variable.  This routine starts the read on a thread of its own; the map
+shown stays in use until the new one has been read, when 'mapLoaded' puts it in
+its place; coarse previews of a large map may be shown by 'previewLoaded' as the
+read goes on.  A read still going is cancelled, and its map dropped.
 
 Arguments:
 	None.
@@ -241,36 +246,103 @@ Written by Michael R. Greason, ADNET, 24 August 2007.
 void mainWindow::readFile ()
 {
 	if (filename.length() <= 0) return;
-/*
-			Allocate space for the map.
-*/
-	if (map == NULL) map = new HealpixMap();
-	if (map == NULL) 
+	if (loader != NULL)
 	{
-		QMessageBox::critical(this, tr("Skyviewer"),
-			tr("Unable to allocate memory for the map!"),
-			QMessageBox::Ok);
-		return;
+		disconnect(loader, 0, ctl, 0);
+		loader->cancel();
 	}
-/*
-			Read the map.
-*/
-	try {
-		map->readFITS(filename, ctl);
-	}
-	catch (MapException &exc)
+	loader = new MapLoader(filename, precision, storage, sparse, this);
+	connect(loader, &MapLoader::progress, ctl, &ControlDialog::loadProgress);
+	connect(loader, &MapLoader::previewReady, this, &mainWindow::previewLoaded);
+	connect(loader, &QThread::finished,   this, &mainWindow::mapLoaded);
+	loader->start();
+}
+/* ------------------------------------------------------------------------------------
+'mapLoaded' responds to the end of a read.  The map read replaces the one shown,
+or the last preview of it.  The map of a superseded read is dropped; if the read
+fails, whatever was last shown stays.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+------------------------------------------------------------------------------------ */
+void mainWindow::mapLoaded ()
+{
+	MapLoader *done = qobject_cast<MapLoader*>(sender());
+	if (done == NULL) return;
+	done->deleteLater();
+	if (done != loader) return;
+	loader = NULL;
+	HealpixMap *m = done->takeMap();
+	if (m == NULL)
 	{
+		if (done->cancelled()) return;
 		QString msg(tr("Unable to read map: "));
 		QMessageBox::critical(this, tr("Skyviewer Load Error"),
-			(msg + filename + "\nError: " + exc.Message()),
+			(msg + done->fileName() + "\nError: " + done->error()),
 			QMessageBox::Ok);
 		return;
 	}
+	showMap(m);
+}
+/* ------------------------------------------------------------------------------------
+'previewLoaded' responds to a coarse preview of the map being read.  It is shown
+in place of the current map until a finer preview or the map itself arrives.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+------------------------------------------------------------------------------------ */
+void mainWindow::previewLoaded ()
+{
+	if ((loader == NULL) || (sender() != loader)) return;
+	HealpixMap *m = loader->takePreview();
+	if (m != NULL) showMap(m);
+}
+/* ------------------------------------------------------------------------------------
+'showMap' makes a map the one shown.  The map shown before is deleted once the
+texture has let go of it.
+
+Arguments:
+	m - The map, now the window's.
+
+Returned:
+	Nothing.
+------------------------------------------------------------------------------------ */
+void mainWindow::showMap (HealpixMap *m)
+{
+	HealpixMap *old = map;
+	map = m;
+/*
+			Tell the control window what was read.
+*/
+	ctl->hasField(I,    map->has_Temperature());
+	ctl->hasField(Q,    map->has_Polarization());
+	ctl->hasField(U,    map->has_Polarization());
+	ctl->hasField(P,    map->has_Polarization());
+	ctl->hasField(Nobs, map->has_Nobs());
+	ctl->loadField(I);
+	if (map->has_Polarization())
+	{
+		ctl->loadField(Q);
+		ctl->loadField(U);
+		ctl->loadField(P);
+	}
+	if (map->has_Nobs()) ctl->loadField(Nobs);
+	ctl->loadNSide(map->nside(), map->pixordenum());
+	ctl->finished(map);
+
 	ctl->init(map);
+	overlay->set(map);
 	setFieldEnables();
 	
 /*
 			Create the texture and polarization angle vectors (if needed).
+			Once the texture has let go of the old map it can be deleted.
 */
 	if (showtex)
 	{
@@ -280,6 +352,7 @@ void mainWindow::readFile ()
 		}
 		catch (MapException &exc)
 		{
+			delete old;
 			QString msg(tr("Unable to read map: "));
 			QMessageBox::critical(this, tr("Skyviewer"),
 				(exc.Comment() == NULL) ? (msg + filename) : tr(exc.Comment()),
@@ -287,6 +360,7 @@ void mainWindow::readFile ()
 			return;
 		}
 	}
+	delete old;
 	if (showpolar && map->has_Polarization())
 	{
 		if (polarsphere != NULL) polarsphere->set(map);
@@ -473,7 +547,7 @@ void mainWindow::newRigging(void)
 		viewmoll = rngctl->getProjection() == Mollweide;
 		viewer->constrainMollweide(viewmoll);
 		rigging->generate (rngctl->getRigging(), viewmoll);
-		whiterig->generate(rngctl->getRigging(), viewmoll, WhiteRiggingRadius);
+		overlay->setMollweide(viewmoll);
 		polarsphere->setMollweide(viewmoll);
 		viewer->update();
 	}
@@ -651,11 +725,20 @@ Returned:
 
 Written by Michael R. Greason, ADNET, 29 August 2007.
 ------------------------------------------------------------------------------------ */
-int mainWindow::selectPixel (int pix)
+PixIndex mainWindow::selectPixel (PixIndex pix)
 {
-	if( ! ctl->selectPixel(pix,&((*map)[pix])) ) {
-		texture->highlite(pix, 1.0);
+	bool set;
+	PixIndex k = map->find(pix);
+	if (k >= 0) {
+		const Skymap &m = *map;		// Read a copy; the map is left alone.
+		MapPixel p = m[k];
+		set = ctl->selectPixel(pix,&p);
+	}
+	else {
+		TPnobsPixel p;		// Missing or unobserved, so not stored; all zero.
+		set = ctl->selectPixel(pix,&p);
 	}
+	overlay->select(pix, set);
 	if ( ctl->numselected() <= 0) {
 		if (viewer->animationIsStarted()) viewer->stopAnimation();
 	}
@@ -679,38 +762,22 @@ Returned:
 
 Written by Michael R. Greason, ADNET, 29 August 2007.
 ------------------------------------------------------------------------------------ */
-int mainWindow::selectPixel (double theta, double phi)
+PixIndex mainWindow::selectPixel (double theta, double phi)
 {
-	int pix;
-	long p;
+	PixIndex pix;
 
 	//Convert the coordinate into a pixel number.
-	map->angles2pixel(theta, phi, p);
-	pix = int(p);
+	map->angles2pixel(theta, phi, pix);
 
 	// Process the pixel.
 	return selectPixel(pix);
 }
-/* ------------------------------------------------------------------------------------
-'highlightPixels' adjusts the opacity of the selected pixels.
-
-Arguments:
-	hlite - The opacity level to assign to the selected pixels.
-
-Returned:
-	Nothing.
-
-Written by Michael R. Greason, ADNET, 29 August 2007.
------------------------------------------------------------------------------------- */
-void mainWindow::highlightPixels (double hlite)
-{
-	for(int i = 0; i < ctl->numselected(); i ++ )
-		texture->highlite(ctl->pixnum(i), float(hlite));
-}
-void mainWindow::unselectPixels(std::vector<int> pixs)
+void mainWindow::unselectPixels(std::vector<PixIndex> pixs)
 {
 	for(uint i = 0; i < pixs.size(); i ++ )
-		texture->highlite(pixs[i], 1.0);
+		overlay->select(pixs[i], false);
+	if ((ctl->numselected() <= 0) && viewer->animationIsStarted()) viewer->stopAnimation();
+	viewer->update();
 	return;
 }
 /* ----------------------------------------------------------------------------
@@ -719,7 +786,7 @@ void mainWindow::unselectPixels(std::vector<int> pixs)
 	of selected pixels.
 
 Arguments:
-	int pixnum: Pixel number to center on, assumed to index into the
+	PixIndex pixnum: Pixel number to center on, assumed to index into the
 			current set sky map.
 
 Returned:
@@ -727,7 +794,7 @@ Returned:
 
 Written by Nicholas Phillips, 10/14/08
 ---------------------------------------------------------------------------- */
-void mainWindow::recenterOnPixel(int pixnum)
+void mainWindow::recenterOnPixel(PixIndex pixnum)
 {
 	double theta,phi;
 	map->pixel2angles(pixnum, theta, phi);
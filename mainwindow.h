@@ -22,6 +22,7 @@ QT4 implementation.  Michael R. Greason, ADNET, 23 August 2007.
 
 class ControlDialog;
 class RangeControl;
+class MapLoader;
 
 /*
 class SelectedPixelModel : public QAbstractTableModel
@@ -61,14 +62,22 @@ public slots:
 	virtual void newField();
 	virtual void newPolVect();
 
-	virtual void unselectPixels(std::vector<int>);
-	virtual void recenterOnPixel(int pixnum);
+	virtual void unselectPixels(std::vector<PixIndex>);
+	virtual void recenterOnPixel(PixIndex pixnum);
+
+private slots:
+	void mapLoaded();
+	void previewLoaded();
 
 private:
 	HealpixMap      *map;
+	MapLoader       *loader;		// The read in progress; NULL if none
+	Skymap::Precision precision;	// Storage precision for loaded maps
+	Skymap::Storage   storage;		// Column storage for loaded maps
+	bool              sparse;		// Store only observed pixels if smaller
 	SkyTexture      *texture;
 	Rigging         *rigging;
-	Rigging         *whiterig;
+	SelectionOverlay *overlay;
 	Rigging         *blackrig;
 	PolarArgLineSet *polarsphere;
 
@@ -86,6 +95,7 @@ private:
 	QLabel     *maplabel;
 
 	void setFieldEnables();
+	void showMap (HealpixMap *m);
 
 	void fileFileInfo (bool b);
 
@@ -100,8 +110,22 @@ public:
 
 	bool currentMollweide (void) const { return viewmoll; }
 
-	int  selectPixel (int pix);
-	int  selectPixel (double phi, double lambda);
-	void highlightPixels (double hlite);
+	// Storage precision used for subsequent loads.
+	void setPrecision (Skymap::Precision p) { precision = p; }
+	Skymap::Precision getPrecision (void) const { return precision; }
+
+	// Column storage used for subsequent loads.
+	void setStorage (Skymap::Storage s) { storage = s; }
+	Skymap::Storage getStorage (void) const { return storage; }
+
+	// Whether cut-sky maps are stored sparsely on subsequent loads.
+	void setSparse (bool b) { sparse = b; }
+	bool getSparse (void) const { return sparse; }
+
+	// Texture kept as RGBA (0) or as 8- or 16-bit palette indices.
+	void setIndexedTexture (int bits) { texture->setIndexed(bits); }
+
+	PixIndex selectPixel (PixIndex pix);
+	PixIndex selectPixel (double phi, double lambda);
 };
 #endif
@@ -70,6 +70,9 @@ const char* MapException::Message (void) const
 	    	if (status_ != 0) sprintf(msg, "FITS I/O Error:  %d", status_);
 			             else strcpy(msg, "FITS I/O Error");
 			break;
+		case Cancelled:
+			strcpy(msg, "Read cancelled.");
+			break;
 		default:
 			*msg = '\0';
 			break;
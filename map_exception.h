@@ -20,6 +20,7 @@ class MapException
 			Undefined,		// Requested element undefined.
 			InvalidType,	// Invalid map type requested.
 			FITSError,		// A FITS I/O error.
+			Cancelled,		// A read was cancelled.
 			Other			// Other error.
 		};
 	protected:
@@ -0,0 +1,338 @@
+/* ============================================================================
+'maploader.cpp' defines the thread that reads a map from a FITS file apart
+from the GUI.  The class is defined in 'maploader.h'.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <new>
+#include <exception>
+#include <cmath>
+#include <limits>
+#include <QMutexLocker>
+#include "maploader.h"
+#include "map_exception.h"
+
+using namespace std;
+/* ----------------------------------------------------------------------------
+'MapLoader' is the class constructor.  The read starts with start().
+
+Arguments:
+	filename  - The file to read.
+	p         - The storage precision for the map.
+	s         - The column storage for the map.
+	sparse_in - Store only the observed pixels, if that is smaller?
+	parent    - The owner of the loader.
+---------------------------------------------------------------------------- */
+MapLoader::MapLoader(const QString &filename, Skymap::Precision p, Skymap::Storage s,
+	bool sparse_in, QObject *parent) : QThread(parent), file(filename), precision(p),
+	storage(s), sparse(sparse_in), map(NULL), preview(NULL)
+{
+	prog.loader  = this;
+	prog.pct     = -1;
+	prog.quarter = 0;
+	prog.nside   = 0;
+	prog.nsFine  = 0;
+	prog.type    = Skymap::none;
+}
+/* ----------------------------------------------------------------------------
+'~MapLoader' is the class destructor.  A read still going is cancelled and
+waited for; a map not taken is deleted.
+
+Arguments:
+	None.
+---------------------------------------------------------------------------- */
+MapLoader::~MapLoader()
+{
+	cancel();
+	wait();
+	delete map;
+	delete preview;
+}
+/* ----------------------------------------------------------------------------
+'takeMap' hands over the map read.
+
+Arguments:
+	None.
+
+Returned:
+	The map, now the caller's, or NULL if the read failed or was cancelled.
+---------------------------------------------------------------------------- */
+HealpixMap *MapLoader::takeMap()
+{
+	HealpixMap *m = map;
+	map = NULL;
+	return m;
+}
+/* ----------------------------------------------------------------------------
+'takePreview' hands over the latest preview of the map being read.  It may be
+called while the read goes on.
+
+Arguments:
+	None.
+
+Returned:
+	The preview, now the caller's, or NULL if there is none new.
+---------------------------------------------------------------------------- */
+HealpixMap *MapLoader::takePreview()
+{
+	QMutexLocker lock(&previewLock);
+	HealpixMap *m = preview;
+	preview = NULL;
+	return m;
+}
+/* ----------------------------------------------------------------------------
+'run' reads the map, as a separate thread from the GUI.  The map is only kept
+if the read completes; otherwise why it failed is kept instead, whatever was
+thrown, as nothing may escape the thread.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void MapLoader::run()
+{
+	HealpixMap *m = NULL;
+	try {
+		m = new HealpixMap();
+		m->setPrecision(precision);
+		m->setStorage(storage);
+		m->setSparseLoad(sparse);
+		m->setLoadProgress(&prog);
+		m->readFITS(file, NULL);
+		m->setLoadProgress(NULL);
+		map = m;
+	}
+	catch (MapException &exc)
+	{
+		err = exc.Message();
+		delete m;
+	}
+	catch (std::bad_alloc &)
+	{
+		err = MapException(MapException::Memory).Message();
+		delete m;
+	}
+	catch (std::exception &exc)
+	{
+		err = exc.what();
+		delete m;
+	}
+	catch (...)
+	{
+		err = "Unknown error.";
+		delete m;
+	}
+	return;
+}
+/* ----------------------------------------------------------------------------
+'changed' signals the progress of the read, each time another percent of the
+file has been read.  It is called on the reading thread.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void MapLoader::Progress::changed()
+{
+	long long t = total;
+	if ((nsFine != 0) && (t > 0) && ! cancel)
+	{
+		int q = int((4 * (long long)(done)) / t);
+		if ((q > quarter) && (q < 4))
+		{
+			quarter = q;
+			publish(nsFine, true);
+		}
+	}
+	int p = (t > 0) ? int((100 * (long long)(done)) / t) : 0;
+	if (p == pct) return;
+	pct = p;
+	emit loader->progress(done, t);
+}
+/* ----------------------------------------------------------------------------
+'starting' decides, once the map is allocated, whether it is worth previewing:
+a full-sky NESTED map of nside previewFrom or more.  If so it asks for a
+sample of one entry per pixel at nside previewCoarse, the one by the pixel's
+centre, and, if the map is finer than previewFine, for chunks of whole pixels
+at that nside.  It is called on the reading thread.
+
+Arguments:
+	m - The map being read.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void MapLoader::Progress::starting(const Skymap &m)
+{
+	nside   = nsFine = 0;
+	quarter = 0;
+	const HealpixMap *h = dynamic_cast<const HealpixMap*>(&m);
+	if ((h == NULL) || (h->pixordenum() != HealpixMap::Nested) || m.sparse()) return;
+	unsigned int ns = HealpixMap::NPix2NSide(m.size());
+	if ((ns < previewFrom) || ((ns & (ns - 1)) != 0) ||
+	    (HealpixMap::NSide2NPix(ns) != m.size())) return;
+	nside = ns;
+	type  = m.type();
+/*
+			Of the 4^k entries of a coarse pixel, entry 3 * 4^(k-1) is one of
+			the four about its centre.
+*/
+	PixIndex r   = PixIndex(ns / previewCoarse) * (ns / previewCoarse);
+	sampleStride = r;
+	sampleOffset = 3 * (r / 4);
+	if (ns <= previewFine) return;
+	try {
+		const PixIndex nf = HealpixMap::NSide2NPix(previewFine);
+		for (int c = Skymap::TCol; c <= Skymap::NobsCol; c++)
+		{
+			fine[c].clear();
+			if (m.has_Column(Skymap::Column(c)))
+				fine[c].assign(nf, std::numeric_limits<float>::quiet_NaN());
+		}
+		std::vector<std::atomic<unsigned char> >(nf).swap(ready);
+		nsFine     = previewFine;
+		chunkAlign = PixIndex(ns / nsFine) * (ns / nsFine);
+	}
+	catch (std::bad_alloc &)
+	{
+		for (int c = Skymap::TCol; c <= Skymap::NobsCol; c++)
+			std::vector<float>().swap(fine[c]);
+	}
+}
+/* ----------------------------------------------------------------------------
+'sampled' keeps the sample, which is all in the map, and sends it as the first
+preview.  It is called on the reading thread before any chunk is read.
+
+Arguments:
+	m - The map being read.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void MapLoader::Progress::sampled(const Skymap &m)
+{
+	if (nside == 0) return;
+	const PixIndex nc  = HealpixMap::NSide2NPix(previewCoarse);
+	const float    nan = std::numeric_limits<float>::quiet_NaN();
+	for (int c = Skymap::TCol; c <= Skymap::NobsCol; c++)
+	{
+		Skymap::Column col = Skymap::Column(c);
+		coarse[c].clear();
+		if (! m.has_Column(col)) continue;
+		coarse[c].resize(nc);
+		for (PixIndex j = 0; j < nc; j++)
+		{
+			PixIndex e = j * sampleStride + sampleOffset;
+			coarse[c][j] = m.valid(e) ? float(m.value(col, e)) : nan;
+		}
+	}
+	publish(previewCoarse, false);
+}
+/* ----------------------------------------------------------------------------
+'chunkRead' averages the valid entries of each pixel at nside nsFine within a
+chunk just read, and marks the pixel done.  A chunk holds whole pixels.  As in
+'degrade_map', N_obs is summed.  It is called on whichever thread read the
+chunk, each of which has pixels of its own.
+
+Arguments:
+	m        - The map being read.
+	first    - The first entry of the chunk.
+	n        - The entries of the chunk.
+	invalid  - The entries of the chunk flagged as missing, in order.
+	ninvalid - How many there are.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void MapLoader::Progress::chunkRead(const Skymap &m, PixIndex first, PixIndex n,
+	const PixIndex *invalid, size_t ninvalid)
+{
+	if (nsFine == 0) return;
+	const PixIndex r = chunkAlign;
+	size_t k = 0;
+	for (PixIndex j = first / r; j < (first + n) / r; j++)
+	{
+		double   acc[Skymap::NumCols] = { 0 };
+		PixIndex cnt = 0;
+		for (PixIndex e = j * r; e < (j + 1) * r; e++)
+		{
+			while ((k < ninvalid) && (invalid[k] < e)) k++;
+			if ((k < ninvalid) && (invalid[k] == e)) continue;
+			cnt++;
+			for (int c = Skymap::TCol; c <= Skymap::NobsCol; c++)
+				if (! fine[c].empty()) acc[c] += m.value(Skymap::Column(c), e);
+		}
+		for (int c = Skymap::TCol; c <= Skymap::NobsCol; c++)
+		{
+			if (fine[c].empty()) continue;
+			if (cnt == 0) fine[c][j] = std::numeric_limits<float>::quiet_NaN();
+			else fine[c][j] = float((c == Skymap::NobsCol) ? acc[c] : acc[c] / double(cnt));
+		}
+		ready[j].store(1, std::memory_order_release);
+	}
+}
+/* ----------------------------------------------------------------------------
+'publish' makes a preview and signals it, replacing any not yet taken.  Each
+pixel comes from its run average if that is done and the sample otherwise; a
+sampled N_obs is scaled up to stand for the pixel's entries.  A preview that
+cannot be made is skipped.  It is called on the reading thread.
+
+Arguments:
+	ns      - The nside of the preview:  previewCoarse or nsFine.
+	useFine - Use the run averages that are done?
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void MapLoader::Progress::publish(unsigned int ns, bool useFine)
+{
+	const PixIndex np   = HealpixMap::NSide2NPix(ns);
+	const PixIndex per  = PixIndex(ns / previewCoarse) * (ns / previewCoarse);
+	const double   nobs = double(nside / ns) * double(nside / ns);
+	HealpixMap *p = NULL;
+	try {
+		p = new HealpixMap(np, type, HealpixMap::Nested);
+		p->setPrecision(loader->precision);
+		for (PixIndex j = 0; j < np; j++)
+		{
+			bool own = useFine && (ready[j].load(std::memory_order_acquire) != 0);
+			const std::vector<float> *src = own ? fine : coarse;
+			PixIndex i = own ? j : j / per;
+			if (std::isnan(src[Skymap::TCol][i]))
+			{
+				p->setValid(j, false);
+				continue;
+			}
+			for (int c = Skymap::TCol; c <= Skymap::NobsCol; c++)
+			{
+				if (src[c].empty()) continue;
+				double v = src[c][i];
+				if ((c == Skymap::NobsCol) && ! own) v *= nobs;
+				p->setValue(Skymap::Column(c), j, v);
+			}
+		}
+		p->computePolar();
+		p->calcStats();
+	}
+	catch (MapException &)
+	{
+		delete p;
+		return;
+	}
+	catch (std::bad_alloc &)
+	{
+		delete p;
+		return;
+	}
+	{
+		QMutexLocker lock(&loader->previewLock);
+		delete loader->preview;
+		loader->preview = p;
+	}
+	emit loader->previewReady();
+}
@@ -0,0 +1,90 @@
+#ifndef MAPLOADER_H
+#define MAPLOADER_H
+/* ============================================================================
+'maploader.h' defines the thread that reads a map from a FITS file apart from
+the GUI.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <vector>
+#include <atomic>
+#include <QString>
+#include <QMutex>
+#include <qthread.h>
+#include "healpixmap.h"
+/* ============================================================================
+'MapLoader' reads a FITS file into a new HealpixMap on a thread of its own, so
+the window, and the map already shown, stay in use while it reads.  The
+progress is sent as a signal from the reading thread, so it reaches the GUI
+queued, and the thread's finished() signal tells the GUI to take the map.
+
+A read may be cancelled at any time; the reader gives up at the next chunk
+of rows.  A map not taken is deleted with the loader, which first waits for
+the read to stop.
+
+While a large, full-sky NESTED map is read, coarse previews of it are sent
+ahead of it with previewReady().  In NESTED order the 4^k entries of a pixel
+k levels finer are consecutive, so a degraded map is the average of aligned
+runs of entries.  A sample of the centre entry of each pixel at nside
+'previewCoarse' is read first; then, at each quarter of the read, a map at
+nside 'previewFine' is made of the runs read so far, each filled in from the
+sample where its run is still to come.
+============================================================================ */
+class MapLoader : public QThread
+{
+	Q_OBJECT
+private:
+	class Progress : public LoadProgress
+	{
+	public:
+		MapLoader *loader;			// The loader to signal
+		int        pct;				// The percentage last signalled
+		int        quarter;			// The quarter of the read last previewed
+		unsigned int nside;			// Of the map; 0 if there are no previews
+		unsigned int nsFine;		// Of the finer preview; 0 if none
+		Skymap::Type type;			// Of the map
+		std::vector<float> coarse[Skymap::NumCols];	// The sample; NaN if invalid
+		std::vector<float> fine[Skymap::NumCols];	// Run averages; NaN if invalid
+		std::vector<std::atomic<unsigned char> > ready;	// Which runs are averaged
+
+		void starting(const Skymap &m);
+		void sampled(const Skymap &m);
+		void chunkRead(const Skymap &m, PixIndex first, PixIndex n,
+		               const PixIndex *invalid, size_t ninvalid);
+		void changed();
+		void publish(unsigned int ns, bool useFine);
+	};
+	static const unsigned int previewCoarse = 64;	// nside of the first preview
+	static const unsigned int previewFine   = 256;	// nside of the later previews
+	static const unsigned int previewFrom   = 512;	// Least nside worth a preview
+	QString           file;			// The file to read
+	Skymap::Precision precision;	// Storage precision for the map
+	Skymap::Storage   storage;		// Column storage for the map
+	bool              sparse;		// Store only observed pixels if smaller
+	Progress          prog;			// Progress of the read
+	HealpixMap       *map;			// The map read; NULL until read
+	HealpixMap       *preview;		// The latest preview not yet taken, or NULL
+	QMutex            previewLock;	// Guards 'preview'
+	QString           err;			// Why the read failed; empty if it didn't
+
+protected:
+	void run();
+
+signals:
+	void progress(qint64 done, qint64 total);
+	void previewReady();
+
+public:
+	MapLoader(const QString &filename, Skymap::Precision p, Skymap::Storage s,
+	          bool sparse_in, QObject *parent = 0);
+	virtual ~MapLoader();
+
+	void cancel() { prog.cancel = true; }
+	bool cancelled() const { return prog.cancel; }
+	const QString &fileName() const { return file; }
+	const QString &error() const { return err; }
+	HealpixMap *takeMap();
+	HealpixMap *takePreview();
+};
+#endif
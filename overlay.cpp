@@ -0,0 +1,250 @@
+/* ============================================================================
+'overlay.cpp' defines the layer that marks the selected pixels on the viewer.
+The class is defined in 'overlay.h'.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <math.h>
+#include <algorithm>
+#include "overlay.h"
+#include "tiles.h"
+#include "heal.h"
+
+using namespace std;
+
+const double boost = 0.001; 	// Distance to raise the quads above the sphere,
+								// or bring them in front of the plane.
+/* ----------------------------------------------------------------------------
+'faceToSky' finds the sky position of a point of a HealPix base face.
+
+Arguments:
+	face - The base face, 0--11.
+	x,y  - The position within the face, each 0--1, x along the bits of a
+	       NESTED pixel number that 'xy2pix' takes from its first argument.
+
+Returned:
+	z    - The cosine of the colatitude.
+	phi  - The longitude in radians, 0--2PI.
+---------------------------------------------------------------------------- */
+static void faceToSky(int face, double x, double y, double &z, double &phi)
+{
+	static const int jrll[12] = { 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+	static const int jpll[12] = { 1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7 };
+	double jr = jrll[face] - x - y;
+	double nr;
+	if (jr < 1.)
+	{
+		nr = jr;
+		z  = 1. - nr * nr / 3.;
+	}
+	else if (jr > 3.)
+	{
+		nr = 4. - jr;
+		z  = nr * nr / 3. - 1.;
+	}
+	else
+	{
+		nr = 1.;
+		z  = (2. - jr) * 2. / 3.;
+	}
+	double tmp = jpll[face] * nr + x - y;
+	if (tmp < 0.) tmp += 8.;
+	if (tmp >= 8.) tmp -= 8.;
+	phi = (nr < 1e-15) ? 0. : 0.25 * M_PI * tmp / nr;
+}
+/* ----------------------------------------------------------------------------
+'SelectionOverlay' is the class constructor.
+
+Arguments:
+	None.
+---------------------------------------------------------------------------- */
+SelectionOverlay::SelectionOverlay() : moll(false), nside(0),
+	order(HealpixMap::Undefined), cuts(1)
+{
+}
+/* ----------------------------------------------------------------------------
+'set' prepares the overlay for a new map, clearing the selection.
+
+Arguments:
+	map - The map.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::set(HealpixMap *map)
+{
+	clear();
+	nside = map->nside();
+	order = map->pixordenum();
+	cuts  = max(1, min(16, 64 / max(1, nside)));
+	return;
+}
+/* ----------------------------------------------------------------------------
+'setMollweide' chooses between the sphere and the Mollweide projection.
+
+Arguments:
+	b - true for the Mollweide projection.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::setMollweide(bool b)
+{
+	if (b == moll) return;
+	moll = b;
+	rebuild();
+	return;
+}
+/* ----------------------------------------------------------------------------
+'select' adds a pixel to the selection or removes it.
+
+Arguments:
+	pix - The pixel, in the map's ordering.
+	on  - true to add it, false to remove it.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::select(PixIndex pix, bool on)
+{
+	vector<PixIndex>::iterator i = find(pixels.begin(), pixels.end(), pix);
+	if (on && (i == pixels.end()))
+	{
+		pixels.push_back(pix);
+		addQuads(pix);
+	}
+	else if (! on && (i != pixels.end()))
+	{
+		const size_t n = 4 * size_t(cuts) * cuts;
+		const size_t k = size_t(i - pixels.begin());
+		quads.erase(quads.begin() + k * n, quads.begin() + (k + 1) * n);
+		pixels.erase(i);
+	}
+	return;
+}
+/* ----------------------------------------------------------------------------
+'clear' empties the selection.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::clear()
+{
+	pixels.clear();
+	quads.clear();
+	return;
+}
+/* ----------------------------------------------------------------------------
+'rebuild' computes the quads of every selected pixel afresh.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::rebuild()
+{
+	quads.clear();
+	for (size_t i = 0; i < pixels.size(); i++) addQuads(pixels[i]);
+	return;
+}
+/* ----------------------------------------------------------------------------
+'point' places a point of a base face on the sphere, or in the Mollweide
+projection.  Longitudes are taken within PI of a given one, so that the
+points of a pixel on the edge of the Mollweide projection stay together.
+
+Arguments:
+	face    - The base face.
+	x,y     - The position within the face, each 0--1.
+	lambda0 - The longitude, -PI--PI, near which to keep the point.
+
+Returned:
+	p       - The vertex.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::point(int face, double x, double y, double lambda0, GLPoint &p) const
+{
+	double z, phi;
+	faceToSky(face, x, y, z, phi);
+	if (! moll)
+	{
+		p.setVertS(acos(z), phi, 1. + boost);
+		return;
+	}
+	double lambda = phi;
+	while (lambda - lambda0 >  M_PI) lambda -= 2. * M_PI;
+	while (lambda - lambda0 < -M_PI) lambda += 2. * M_PI;
+	double mx, my;
+	::toMollweide(asin(z), lambda, mx, my);
+	p.setVertC(-boost, mx / sqrt(2.), my / sqrt(2.));
+	return;
+}
+/* ----------------------------------------------------------------------------
+'addQuads' appends the quads of a pixel.
+
+Arguments:
+	pix - The pixel, in the map's ordering.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::addQuads(PixIndex pix)
+{
+	if (nside <= 0) return;
+	hpint64 nest = pix;
+	if (order == HealpixMap::Ring) ring2nest64(nside, pix, &nest);
+	const PixIndex area = PixIndex(nside) * nside;
+	const int face = int(nest / area);
+	uint32_t ix, iy;
+	TilePyramid::unnest(uint64_t(nest % area), ix, iy);
+/*
+			The longitude of the centre, then a grid of
+			(cuts + 1)^2 points over the pixel.
+*/
+	double z, phi;
+	faceToSky(face, (ix + 0.5) / nside, (iy + 0.5) / nside, z, phi);
+	const double lambda0 = atan2(sin(phi), cos(phi));
+	const int m = cuts + 1;
+	vector<GLPoint> grid(size_t(m) * m);
+	for (int b = 0; b < m; b++)
+		for (int a = 0; a < m; a++)
+			point(face, (ix + double(a) / cuts) / nside, (iy + double(b) / cuts) / nside,
+			      lambda0, grid[size_t(b) * m + a]);
+	for (int b = 0; b < cuts; b++)
+		for (int a = 0; a < cuts; a++)
+		{
+			quads.push_back(grid[size_t(b)     * m + a]);
+			quads.push_back(grid[size_t(b)     * m + a + 1]);
+			quads.push_back(grid[size_t(b + 1) * m + a + 1]);
+			quads.push_back(grid[size_t(b + 1) * m + a]);
+		}
+	return;
+}
+/* ----------------------------------------------------------------------------
+'draw' draws the selected pixels in one color, in a single call from a
+vertex array.  Texturing should be off.
+
+Arguments:
+	r,g,b - The color, each 0--1.
+	alpha - The opacity, 0--1.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SelectionOverlay::draw(float r, float g, float b, float alpha) const
+{
+	if (quads.empty()) return;
+	glColor4f(r, g, b, alpha);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(-1., -1.);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(GLPoint), &quads[0].x);
+	glDrawArrays(GL_QUADS, 0, GLsizei(quads.size()));
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	return;
+}
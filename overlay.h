@@ -0,0 +1,48 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+/* ============================================================================
+'overlay.h' defines the layer that marks the selected pixels on the viewer.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <vector>
+#include "glpoint.h"
+#include "healpixmap.h"
+/* ============================================================================
+'SelectionOverlay' draws the selected pixels as quads of one color over the
+sky, apart from the texture:  selecting or clearing a pixel changes only its
+own quads, and the pulse of the selection is the color and opacity the quads
+are drawn with, so the texture is never touched and a new texture leaves the
+selection in place.
+
+Each pixel is drawn as k x k quads, its edges cut finely enough to follow the
+sphere, from the HealPix coordinates of the points of its face.  The quads
+sit just above the sphere, or just in front of the Mollweide plane.
+============================================================================ */
+class SelectionOverlay
+{
+protected:
+	bool moll;				// Mollweide projection?
+	int  nside;				// The map's nside...
+	HealpixMap::PixOrder order;		// ...and ordering
+	int  cuts;				// Quads along each pixel edge
+	std::vector<PixIndex> pixels;		// The selected pixels
+	GLVertices quads;			// Four vertices a quad, cuts^2 quads a pixel
+
+	void addQuads(PixIndex pix);
+	void point(int face, double x, double y, double lambda0, GLPoint &p) const;
+	void rebuild();
+public:
+	SelectionOverlay();
+
+	void set(HealpixMap *map);
+	void setMollweide(bool b);
+	void select(PixIndex pix, bool on);
+	void clear();
+	bool empty() const { return pixels.empty(); }
+	size_t size() const { return pixels.size(); }
+
+	void draw(float r, float g, float b, float alpha) const;
+};
+#endif
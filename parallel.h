@@ -0,0 +1,91 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+/* ============================================================================
+'parallel.h' provides a simple way to split a loop over map entries among
+threads.  All functions are inline.
+============================================================================ */
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "pixel.h"
+/* ----------------------------------------------------------------------------
+'parallelThreadsSet' holds the number of threads set by setParallelThreads,
+or 0 for the number of hardware threads.
+---------------------------------------------------------------------------- */
+inline std::atomic<unsigned int> &parallelThreadsSet ()
+{
+	static std::atomic<unsigned int> n(0);
+	return n;
+}
+/* ----------------------------------------------------------------------------
+'parallelThreads' returns the number of threads whole-map loops are split
+among:  the number set by setParallelThreads, or else the number of hardware
+threads, or 1 if that is unknown.
+
+Arguments:
+	None.
+
+Returned:
+	The number of threads.
+---------------------------------------------------------------------------- */
+inline unsigned int parallelThreads ()
+{
+	unsigned int n = parallelThreadsSet().load(std::memory_order_relaxed);
+	if (n == 0) n = std::thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+/* ----------------------------------------------------------------------------
+'setParallelThreads' sets the number of threads whole-map loops are split
+among, so that a threaded path can be run, or compared with a serial one,
+whatever the machine.
+
+Arguments:
+	n - The number of threads, or 0 for the number of hardware threads.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+inline void setParallelThreads (unsigned int n)
+{
+	parallelThreadsSet().store(n, std::memory_order_relaxed);
+}
+/* ----------------------------------------------------------------------------
+'parallelFor' splits the entries 0 to n - 1 into one contiguous range per
+thread and calls a function on each range, the first on the calling thread.
+It returns once all ranges are done.  Range boundaries fall on multiples of
+64, so ranges never share a word of a BitMask.  Loops too short to be worth
+splitting run on the calling thread alone.
+
+The function must not throw.
+
+Arguments:
+	n     - The number of entries.
+	grain - The fewest entries worth giving a thread.
+	f     - The function, called as f(t, begin, end) with the thread number
+	        t (0 to parallelThreads() - 1) and the entries begin to end - 1.
+
+Returned:
+	The number of ranges, and so of threads, used.
+---------------------------------------------------------------------------- */
+template <class F>
+inline unsigned int parallelFor (PixIndex n, PixIndex grain, F f)
+{
+	if (n <= 0) return 0;
+	if (grain < 64) grain = 64;
+	PixIndex nt = std::min(PixIndex(parallelThreads()), (n + grain - 1) / grain);
+	if (nt <= 1)
+	{
+		f(0u, PixIndex(0), n);
+		return 1;
+	}
+	PixIndex chunk = (((n + nt - 1) / nt) + 63) & ~PixIndex(63);
+	nt = (n + chunk - 1) / chunk;
+	std::vector<std::thread> pool;
+	for (PixIndex t = 1; t < nt; t++)
+		pool.push_back(std::thread(f, unsigned(t), t * chunk, std::min(n, (t + 1) * chunk)));
+	f(0u, PixIndex(0), std::min(n, chunk));
+	for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+	return unsigned(nt);
+}
+#endif
@@ -4,6 +4,8 @@
 
 Written by Nicholas Phillips, December 2006
 Broken out of 'skymap.h'.  MRG, ADNET, 23 January 2007.
+MapPixel added for column-stored maps.
+MapPixel supports single-precision columns.
 ============================================================================ */
 #include <math.h>
 #include "pixel.h"
@@ -113,7 +115,7 @@ Returned:
 
 Written by Michael R. Greason, ADNET, 27 March 2007.
 ---------------------------------------------------------------------------- */
-void BasePixel::copy (BasePixel& src)
+void BasePixel::copy (const BasePixel& src)
 {
 	try { this->T()    = src.T();    } catch (MapException &exc) { ; }
 	try { this->Q()    = src.Q();    } catch (MapException &exc) { ; }
@@ -163,3 +165,131 @@ void TPPixel::computePolar (void)
 	Pmag_ = sqrt( (Q_ * Q_) + (U_ * U_) );
 	Pang_ = atan2(U_, Q_) / 2.;
 }
+/* ============================================================================
+The MapPixel class is a view of a single pixel in a column-stored map.
+============================================================================ */
+/* ----------------------------------------------------------------------------
+'MapPixel' is the class constructor.
+
+Arguments:
+	cols   - The six field columns of the map, in BasePixel::operator[] order.
+	         Columns that are not stored are NULL.
+	single - true if the columns hold floats, false if they hold doubles.
+	i      - The index of the pixel in the columns.
+
+Returned:
+	N/A.
+---------------------------------------------------------------------------- */
+MapPixel::MapPixel (void * const *cols, bool single, PixIndex i)
+{
+	for (int c = 0; c < 6; c++)
+	{
+		v_[c] = 0;
+		f_[c] = 0;
+		c_[c] = 0;
+		if (cols[c] == 0) continue;
+		if (single)
+		{
+			f_[c] = static_cast<float*>(cols[c]) + i;
+			c_[c] = *f_[c];
+			v_[c] = &c_[c];
+		}
+		else
+		{
+			v_[c] = static_cast<double*>(cols[c]) + i;
+		}
+	}
+}
+/* ----------------------------------------------------------------------------
+'MapPixel' is the read-only constructor.  The pixel's fields are copied into
+the view, which is never written back to the map.
+
+Arguments:
+	cols   - The six field columns of the map, in BasePixel::operator[] order.
+	         Columns that are not stored are NULL.
+	single - true if the columns hold floats, false if they hold doubles.
+	i      - The index of the pixel in the columns.
+
+Returned:
+	N/A.
+---------------------------------------------------------------------------- */
+MapPixel::MapPixel (const void * const *cols, bool single, PixIndex i)
+{
+	for (int c = 0; c < 6; c++)
+	{
+		v_[c] = 0;
+		f_[c] = 0;
+		c_[c] = 0;
+		if (cols[c] == 0) continue;
+		c_[c] = single ? double(static_cast<const float*>(cols[c])[i])
+		               : static_cast<const double*>(cols[c])[i];
+		v_[c] = &c_[c];
+	}
+}
+/* ----------------------------------------------------------------------------
+'MapPixel' is the copy constructor.  The new view refers to the same pixel;
+cached values are carried over, and written back only if the source's were.
+
+Arguments:
+	src - The view to copy.
+
+Returned:
+	N/A.
+---------------------------------------------------------------------------- */
+MapPixel::MapPixel (const MapPixel &src) : BasePixel()
+{
+	for (int c = 0; c < 6; c++)
+	{
+		f_[c] = src.f_[c];
+		c_[c] = src.c_[c];
+		v_[c] = (src.v_[c] == &src.c_[c]) ? &c_[c] : src.v_[c];
+	}
+}
+/* ----------------------------------------------------------------------------
+'~MapPixel' is the class destructor.  Cached single-precision values are
+written back to the map.
+
+Arguments:
+	None.
+
+Returned:
+	N/A.
+---------------------------------------------------------------------------- */
+MapPixel::~MapPixel ()
+{
+	for (int c = 0; c < 6; c++)
+	{
+		if (f_[c] != 0) *f_[c] = float(c_[c]);
+	}
+}
+/* ----------------------------------------------------------------------------
+'maxIndex' returns the maximum index number allowed when indexing into the
+pixel as an array.
+
+Arguments:
+	None.
+
+Returned:
+	The maximum index of a stored field.
+---------------------------------------------------------------------------- */
+unsigned int MapPixel::maxIndex (void) const
+{
+	for (int c = 5; c > 0; c--) if (v_[c] != 0) return c;
+	return 0;
+}
+/* ----------------------------------------------------------------------------
+'computePolar' computes the polarization magnitude and angle, if the map
+stores them.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void MapPixel::computePolar (void)
+{
+	if ((v_[1] == 0) || (v_[2] == 0) || (v_[4] == 0) || (v_[5] == 0)) return;
+	*v_[4] = sqrt( (*v_[1] * *v_[1]) + (*v_[2] * *v_[2]) );
+	*v_[5] = atan2(*v_[2], *v_[1]) / 2.;
+}
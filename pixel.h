@@ -9,8 +9,17 @@ Adapted for WMAP.  FITS and copy operator added.  Michael R. Greason, ADNET,
 	27 December 2006.
 Broken out of 'skymap.h'.  MRG, ADNET, 23 January 2007.
 Polarization magnitude and angle support.  MRG, ADNET, 30 August 2007.
+MapPixel added for column-stored maps.
+MapPixel supports single-precision columns.
+64-bit pixel index type.
 ============================================================================ */
+#include <stdint.h>
 #include "map_exception.h"
+/*
+			Pixel numbers and counts.  64 bits are needed above nside 8192;
+			this matches the HEALPix C library's 64-bit interface.
+*/
+typedef int64_t PixIndex;
 /* ============================================================================
 The BasePixel class provides a common denominator for the various types of
 supported maps.  Up to six data elements per pixel are supported:
@@ -42,10 +51,10 @@ class BasePixel
 		virtual double   Pang() const;
 		virtual double & Pang()      ;
 		
-		virtual void copy (BasePixel& src);
+		virtual void copy (const BasePixel& src);
 		virtual void clear (void);
 		
-		BasePixel& operator= (BasePixel& src);
+		BasePixel& operator= (const BasePixel& src);
 		double operator[](unsigned int i) const;
 		double & operator[](unsigned int i);
 		virtual unsigned int maxIndex (void) const;
@@ -60,7 +69,7 @@ Arguments:
 Returned:
 	*this - A reference to this pixel.
 ---------------------------------------------------------------------------- */
-inline BasePixel& BasePixel::operator= (BasePixel& src)
+inline BasePixel& BasePixel::operator= (const BasePixel& src)
 {
 	copy(src);
 	return *this;
@@ -220,4 +229,62 @@ class TPnobsPixel : public TPPixel
 		virtual double  & Nobs()       { return nobs_; };
 		virtual unsigned int maxIndex (void) const { return 6; }
 };
+/* ============================================================================
+The MapPixel class is a view of a single pixel in a map that stores each of
+its fields in a separate contiguous column (see 'skymap.h').  It holds a
+pointer to the pixel's element in each column; fields that the map does not
+store are NULL and throw an exception when accessed, as in the classes above.
+
+Single-precision columns cannot be referenced as doubles, so their values are
+cached in the view and written back to the map when the view is destroyed.
+A view of a const map caches every field and never writes back, so it can be
+read, or even changed, without touching the map.
+
+A MapPixel is only valid as long as the map's storage is not reallocated.
+============================================================================ */
+class MapPixel : public BasePixel
+{
+	protected:
+		double *v_[6];		// The fields; NULL if not stored
+		float  *f_[6];		// Single-precision fields to write back
+		double  c_[6];		// Cached single-precision values
+		double& ref (unsigned int c) const;
+	public:
+		MapPixel (void * const *cols, bool single, PixIndex i);
+		MapPixel (const void * const *cols, bool single, PixIndex i);
+		MapPixel (const MapPixel &src);
+		virtual ~MapPixel();
+		MapPixel& operator= (const MapPixel &src) { copy(src); return *this; }
+		virtual double   T()    const { return ref(0); };
+		virtual double & T()          { return ref(0); };
+		virtual double   I()    const { return ref(0); };
+		virtual double & I()          { return ref(0); };
+		virtual double   Q()    const { return ref(1); };
+		virtual double & Q()          { return ref(1); };
+		virtual double   U()    const { return ref(2); };
+		virtual double & U()          { return ref(2); };
+		virtual double   Nobs() const { return ref(3); };
+		virtual double & Nobs()       { return ref(3); };
+		virtual double   Pmag() const { return ref(4); };
+		virtual double & Pmag()       { return ref(4); };
+		virtual double   Pang() const { return ref(5); };
+		virtual double & Pang()       { return ref(5); };
+		virtual unsigned int maxIndex (void) const;
+		virtual void computePolar (void);
+};
+/* ----------------------------------------------------------------------------
+'ref' returns a reference to one of the pixel's fields.
+
+Arguments:
+	c - The field index, as in BasePixel::operator[].
+
+Returned:
+	A reference to the field.  An exception is thrown if the field is not
+	stored by the map.
+---------------------------------------------------------------------------- */
+inline double& MapPixel::ref (unsigned int c) const
+{
+	if (v_[c] == 0) throw MapException(MapException::Undefined);
+	return *v_[c];
+}
 #endif
@@ -214,17 +214,18 @@ Written by Nicholas Phillips.
 ---------------------------------------------------------------------------- */
 void PolarArgLineSet::set(HealpixMap *skymap)
 {
-	long   i, nsiz, npix;
+	PixIndex i, nsiz, npix;
 	double theta,phi;
 	double pixsize;
 	if (! (skymap->has_Polarization() && skymap->has_Nobs())) return;
 /*
-			Start assuming the entire map.  Discard pixels with no observations.
+			Start assuming the entire map.  Discard pixels with no observations
+			or missing data.
 */
-	nsiz = npix = skymap->size();
+	nsiz = npix = skymap->size();		// Only the stored entries of a sparse map.
 	for (i = 0; i < nsiz; i++)
 	{
-		if ((*skymap)[i].Nobs() <= 0) npix--;
+		if ((! skymap->valid(i)) || (skymap->value(Skymap::NobsCol, i) <= 0)) npix--;
 	}
 	resize(npix);
 	if (npix <= 0) return;
@@ -235,9 +236,9 @@ void PolarArgLineSet::set(HealpixMap *skymap)
 	pixsize = (sqrt(M_PI / 3.) / skymap->nside()) / 2.;
 	for (i = 0; i < nsiz; i++)
 	{
-		if ((*skymap)[i].Nobs() <= 0) continue;
-		skymap->pixel2angles(i, theta, phi);
-		it->set(theta, phi, (*skymap)[i].Pang(), pixsize);
+		if ((! skymap->valid(i)) || (skymap->value(Skymap::NobsCol, i) <= 0)) continue;
+		skymap->pixel2angles(skymap->pixel(i), theta, phi);
+		it->set(theta, phi, skymap->value(Skymap::PangCol, i), pixsize);
 		++it;
 	}
 	return;
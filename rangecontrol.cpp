@@ -167,6 +167,33 @@ void RangeControl::on_colorSelect_activated(int)
 	emit reTextureNeeded();
 }
 /* ------------------------------------------------------------------------------------
+'on_stretchSelect_activated'
+	auto-connected slot to handle a change in the selected color stretch.
+	The items of the ComboBox are in the order of the Stretch enum.
+Arguments:
+
+------------------------------------------------------------------------------------ */
+void RangeControl::on_stretchSelect_activated(int i)
+{
+	if( Stretch(i) == transfer.getStretch() ) return;
+	transfer.set(Stretch(i));
+	updateTransfer();
+	emit reTextureNeeded();
+}
+/* ------------------------------------------------------------------------------------
+'updateTransfer'
+	retabulate the stretch for the current range. Only histogram
+	equalization depends on the range and the data.
+Arguments:
+
+------------------------------------------------------------------------------------ */
+void RangeControl::updateTransfer()
+{
+	if( transfer.getStretch() != Equalize ) return;
+	transfer.set(Equalize, histogramWidget->getHistogram(),
+	             histogramWidget->position(minv), histogramWidget->position(maxv));
+}
+/* ------------------------------------------------------------------------------------
 'on_colorSelect_activated'
 	auto-connected slot to handle a change in the selected color table
 Arguments:
@@ -204,6 +231,7 @@ void RangeControl::updateTexture(float lower, float upper)
 {
 	minv = lower;
 	maxv = upper;
+	updateTransfer();
 	emit reTextureNeeded();
 }
 /* ------------------------------------------------------------------------------------
@@ -9,6 +9,7 @@ The definition of the range control window class.
 */
 #include <vector>
 #include "colortable.h"
+#include "stretch.h"
 #include "ui_rangecontrol.h"
 #include "enums.h"
 
@@ -30,6 +31,8 @@ public:
 	int getMapIndex(void) const;
 	float getMinimum() { return minv; };
 	float getMaximum() { return maxv; };
+	Stretch getStretch() const { return transfer.getStretch(); };
+	const StretchTable &getTransfer() const { return transfer; };
 	int getRigging() const { return rigging; };
 	ColorTable *getColorTable() const;
 
@@ -56,6 +59,7 @@ private:
 
 	float minv;
 	float maxv;
+	StretchTable transfer;		// The current stretch, tabulated
 
 	ColorTableList ctl; 			// List of supported color tables.
 
@@ -68,8 +72,11 @@ private slots:
 	void on_fieldSelect_activated(int);
 	void on_riggingSelect_activated(int);
 	void on_colorSelect_activated(int);
+	void on_stretchSelect_activated(int);
 	void on_polarVectorBox_clicked(bool);
 	// need to update the texture
 	void updateTexture(float l, float u);
+private:
+	void updateTransfer();
 };
 #endif
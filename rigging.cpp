@@ -77,17 +77,18 @@ void Rigging::generate(int ns, bool mp, double rad)
 'draw' paints all the faces.
 
 Arguments:
-	None.
+	tiles - The tiled texture to draw the faces from, or NULL to draw them
+	        from the current texture.  Defaults to NULL.
 
 Returned:
 	Nothing.
 
 Written by Nicholas Phillips.
 ---------------------------------------------------------------------------- */
-void Rigging::draw()
+void Rigging::draw(TileBinder *tiles)
 {
 	for(int i = 0; i < 12; i++)
-		faces[i].draw();
+		faces[i].draw(tiles);
 	return;
 }
 /* ----------------------------------------------------------------------------
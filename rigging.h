@@ -32,7 +32,7 @@ public:
 	Rigging();
 	~Rigging();
 	
-	void draw();
+	void draw(TileBinder *tiles = 0);
 
 	void generate(int ns, bool mp, double rad = 1.);
 
@@ -50,9 +50,9 @@ QVariant SelectedPixelModel::data(const QModelIndex &index, int role) const
 			//----------------------------------------------------------------------
 			case list:
 				if( index.column() == 0 ) {
-					return pixs[index.row()].i;
+					return qlonglong(pixs[index.row()].i);
 				}
-				return (*pixs[index.row()].p)[pidx[index.column()-1]];
+				return pixs[index.row()].p[pidx[index.column()-1]];
 				break;
 			//----------------------------------------------------------------------
 			case stats:
@@ -65,11 +65,11 @@ QVariant SelectedPixelModel::data(const QModelIndex &index, int role) const
 				// No Std Dev for a single data point
 				if( (index.row() == 1) && (n == 1) )
 					return QVariant();
-				return (*pixs[index.row()].p)[pidx[index.column()-1]];
+				return pixs[index.row()].p[pidx[index.column()-1]];
 				break;
 			//----------------------------------------------------------------------
 			case status:
-				int v = (int)(*pixs[index.row()].p)[pidx[index.column()]];
+				int v = (int)pixs[index.row()].p[pidx[index.column()]];
 				if( ! v )
 					return QVariant();
 				if( index.row() == 0 ) {
@@ -96,7 +96,7 @@ QVariant SelectedPixelModel::headerData(const int i, Qt::Orientation /*o*/, int
 	return QVariant();
 }
 
-void SelectedPixelModel::set(Skymap *map)
+void SelectedPixelModel::set(const Skymap *map)
 {
 	beginResetModel();
 	headers.clear();
@@ -132,7 +132,7 @@ void SelectedPixelModel::set(Skymap *map)
 		true:	if pixel was set
 		false:	if pixel was de-selected
 */
-bool SelectedPixelModel::operator()(int i, BasePixel *pix)
+bool SelectedPixelModel::operator()(PixIndex i, BasePixel *pix)
 {
 	beginResetModel();
 	for(PixList::iterator pi = pixs.begin();pi != pixs.end(); pi++) {
@@ -167,10 +167,8 @@ void SelectedPixelModel::asStats(SelectedPixelModel *data)
 	ncols=data4stats->ncols;
 	statnames << "Mean" << "Std Dev" << "Min" << "Max";
 	pixs.clear();
-	TPnobsPixel *dummy;
 	for(int i = 0; i < 4; i++) {
-		dummy = new TPnobsPixel;
-		SelectedPixel sp(1,dummy);
+		SelectedPixel sp(1);
 		pixs.push_back(sp);
 	}
 	nrows = 4;
@@ -187,20 +185,20 @@ void SelectedPixelModel::updateStats()
 	n = data4stats->pixs.size();
 	for(uint i = 0; i < pidx.size(); i++) {
 		int j = pidx[i];
-		(*pixs[2].p)[j] = (*data4stats->pixs[0].p)[j];
-		(*pixs[3].p)[j] = (*data4stats->pixs[0].p)[j];
+		pixs[2].p[j] = data4stats->pixs[0].p[j];
+		pixs[3].p[j] = data4stats->pixs[0].p[j];
 		double ttl = 0;
 		double ttlsqr = 0;
 		for(uint k = 0; k < (unsigned int) n; k++) {
-			double x = (*data4stats->pixs[k].p)[j];
-			if( x < (*pixs[2].p)[j]) (*pixs[2].p)[j] = x;
-			if( x > (*pixs[3].p)[j]) (*pixs[3].p)[j] = x;
+			double x = data4stats->pixs[k].p[j];
+			if( x < pixs[2].p[j]) pixs[2].p[j] = x;
+			if( x > pixs[3].p[j]) pixs[3].p[j] = x;
 			ttl += x;
 			ttlsqr += x*x;
 		}
-		(*pixs[0].p)[j] = ttl/n;
+		pixs[0].p[j] = ttl/n;
 		if( n > 1 ) 
-			(*pixs[1].p)[j] = sqrt(ttlsqr/n - (ttl/n)*(ttl/n));
+			pixs[1].p[j] = sqrt(ttlsqr/n - (ttl/n)*(ttl/n));
 	}
 	endResetModel();
 	return;
@@ -224,10 +222,8 @@ void SelectedPixelModel::asStatus()
 		pidx[4] = 3;
 		ncols = headers.size();
 		pixs.clear();
-		TPnobsPixel *dummy;
 		for(int i = 0; i < 2; i++) {
-			dummy = new TPnobsPixel;
-			SelectedPixel sp(1,dummy);
+			SelectedPixel sp(1);
 			pixs.push_back(sp);
 		}
 		nrows = 2;
@@ -235,7 +231,7 @@ void SelectedPixelModel::asStatus()
 	}
 	for(int i = 0; i < 2; i++) {
 		for(int k = 0; k <  ncols; k++)
-			(*pixs[i].p)[pidx[k]] = 0;
+			pixs[i].p[pidx[k]] = 0;
 	}
 	endResetModel();
 	
@@ -258,7 +254,7 @@ void SelectedPixelModel::hasField(Field f, bool b)
 		case Nobs: i = 4;
 			break;
 	}
-	(*pixs[0].p)[pidx[i]] = b ? 1 : -1;
+	pixs[0].p[pidx[i]] = b ? 1 : -1;
 	endResetModel();
 	return;
 }
@@ -278,41 +274,36 @@ void SelectedPixelModel::loadField(Field f)
 		case Nobs: i = 4;
 			break;
 	}
-	(*pixs[1].p)[pidx[i]] = 1;
+	pixs[1].p[pidx[i]] = 1;
 	endResetModel();
 	return;
 }
-void SelectedPixelModel::asStats(Skymap *map)
+void SelectedPixelModel::asStats(const Skymap *map)
 {
 	beginResetModel();
 	set(map);
 	headers[0] = "Stat";
 	statnames << "Mean" << "Std Dev" << "Min" << "Max";
 	
-	TPnobsPixel *dummy;
 	for(int i = 0; i < 4; i++) {
-		dummy = new TPnobsPixel;
-		SelectedPixel sp(1,dummy);
+		SelectedPixel sp(1);
 		pixs.push_back(sp);
 	}
 	nrows = 4;
-	n = map->size();
+	n = map->numValid();		// Pixels with missing data are skipped.
+	if( n <= 0 ) {
+		mode = stats;
+		endResetModel();
+		return;
+	}
+	// The map caches its column stats, so this costs nothing once computed.
 	for(uint i = 0; i < pidx.size(); i++) {
 		int j = pidx[i];
-		(*pixs[2].p)[j] = (*map)[0][j];
-		(*pixs[3].p)[j] = (*map)[0][j];
-		double ttl = 0;
-		double ttlsqr = 0;
-		for(uint k = 0; k < (unsigned int) n; k++) {
-			double x = (*map)[k][j];
-			if( x < (*pixs[2].p)[j]) (*pixs[2].p)[j] = x;
-			if( x > (*pixs[3].p)[j]) (*pixs[3].p)[j] = x;
-			ttl += x;
-			ttlsqr += x*x;
-		}
-		(*pixs[0].p)[j] = ttl/n;
-		if( n > 1 ) 
-			(*pixs[1].p)[j] = sqrt(ttlsqr/n - (ttl/n)*(ttl/n));
+		const Skymap::Stats &st = map->stats(Skymap::Column(j));
+		pixs[0].p[j] = st.mean;
+		pixs[1].p[j] = st.stddev(false);
+		pixs[2].p[j] = st.mn;
+		pixs[3].p[j] = st.mx;
 	}
 	
 	mode = stats;
@@ -352,7 +343,7 @@ void SelectedPixelModel::writeListToFile (const QString &dst)
 		out << pixs[j].i;
 		for (i = 0; i < nc; i++)
 		{
-			out << (*pixs[j].p)[pidx[i]];
+			out << pixs[j].p[pidx[i]];
 		}
 		out << endl;
 	}
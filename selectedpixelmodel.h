@@ -20,13 +20,18 @@
 
 class Skymap;
 
+/*
+	A selected pixel keeps its own copy of the pixel values; the map
+	only hands out views into its columns.
+*/
 class SelectedPixel
 {
 public:
-	int i;
-	BasePixel *p;
+	PixIndex i;
+	TPnobsPixel p;
 	QString label;
-	SelectedPixel(int j, BasePixel *pp) : i(j), p(pp) {};
+	SelectedPixel(PixIndex j) : i(j) {};
+	SelectedPixel(PixIndex j, BasePixel *pp) : i(j) { p.copy(*pp); };
 };
 /*==================================================================
 	@author Nicholas Phillips <Nicholas.G.Phillips@nasa.gov>
@@ -43,18 +48,18 @@ public:
 	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 	virtual QVariant headerData(const int i, Qt::Orientation o, int role = Qt::DisplayRole) const;
 
-	void set(Skymap *map);
+	void set(const Skymap *map);
 	void asStats(SelectedPixelModel *);
-	void asStats(Skymap *map);
+	void asStats(const Skymap *map);
 
 	void asStatus();
 	void hasField(Field f, bool b);
 	void loadField(Field f);
 
-	bool operator()(int i, BasePixel *pix);
+	bool operator()(PixIndex i, BasePixel *pix);
 
 	int size() const { return pixs.size(); };
-	int pixnum(int i) const { return pixs[i].i; };
+	PixIndex pixnum(int i) const { return pixs[i].i; };
 
 	void clear();
 
@@ -75,7 +80,7 @@ private:
 
 	SelectedPixelModel *data4stats;
 	QStringList statnames;
-	int n;
+	PixIndex n;
 };
 
 #endif
@@ -7,14 +7,65 @@ for static class members are defined in 'skymap.cpp'.
 Written by Nicholas Phillips, December 2006
 Adapted for WMAP.  FITS and copy operator added.  Michael R. Greason, ADNET,
 	27 December 2006.
+Columns may be kept in memory-mapped scratch files.
+Sparse maps that store only the observed pixels.
+Validity mask for missing data.
+Cached per-column statistics.
+Quantiles of the valid values.
+Data generation numbers for caches of the map's contents.
+Map columns read from FITS concurrently.
+FITS tables streamed in chunks of rows, with progress and cancellation.
 ============================================================================ */
+#include <stddef.h>
 #include <fitsio.h>
 #include <QString>
 #include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
 #include "pixel.h"
+#include "bitmask.h"
+#include "enums.h"
 //#include "fileprogress.h"
 
 class ControlDialog;
+class Skymap;
+/* ============================================================================
+'LoadProgress' is shared between a map being read from a FITS file and
+whoever watches the read, possibly from another thread.  The reader counts
+the bytes of the table read so far out of the total, and gives up between
+chunks of rows once 'cancel' is set.
+
+A watcher may override the functions called as the read goes on, to pass the
+progress on or to follow the data as they arrive:
+	starting  - once the map is allocated, before any data are read.  The
+	            watcher may then ask for a sample of the table, one entry
+	            every sampleStride from sampleOffset, to be read first, and
+	            for every chunk to be a multiple of chunkAlign entries.
+	sampled   - once the sample is in the map.
+	chunkRead - as each chunk is in the map, with the entries of the chunk
+	            flagged as missing, on whichever thread read the chunk.
+	changed   - as the count of bytes grows.
+All but chunkRead are called on the thread that called readFITS.
+============================================================================ */
+struct LoadProgress
+{
+	std::atomic<long long> done;		// Bytes of the table read
+	std::atomic<long long> total;		// Bytes of the table to read
+	std::atomic<bool>      cancel;		// Set to stop the read
+	PixIndex sampleStride;				// Entries between samples; 0 for none
+	PixIndex sampleOffset;				// The first entry sampled
+	PixIndex chunkAlign;				// Entries a chunk is a multiple of; 0 for any
+
+	LoadProgress () : done(0), total(0), cancel(false), sampleStride(0),
+		sampleOffset(0), chunkAlign(0) {}
+	virtual ~LoadProgress () {}
+	virtual void starting (const Skymap &) {}
+	virtual void sampled (const Skymap &) {}
+	virtual void chunkRead (const Skymap &, PixIndex /*first*/, PixIndex /*n*/,
+	                        const PixIndex * /*invalid*/, size_t /*ninvalid*/) {}
+	virtual void changed () {}
+};
 /* =============================================================================
 The Skymap class defines a collection of pixels to represent a sky map.
 This version allows for dynamically selecting how much information is stored 
@@ -23,15 +74,39 @@ polarization and number of observations.  This class has no knowledge of the
 pixel formatting; it is up to child classes to provide this information.
 
 When set() is called, memory is allocated for the type of pixel requested.
-The address is stored in the appropiate data points (tpix, tppix, etc) and
-the member function pointer returnfct is set to point to the corresponding
-indexing method (returnTpix, etc). Now when the indexing operator[] is called,
-this is inlined de-referenced to the correct index method.  In turn, this method 
-is just an inlined index into the corresponding data array.
+Each field (T, Q, U, Nobs, Pmag, Pang) is stored in its own contiguous column
+of n() values; columns for fields the Type does not carry are left NULL.  The
+values are floats or doubles according to the map's Precision, which is
+chosen with setPrecision() before the map is set or read.  The columns live
+on the heap or, with setStorage(Scratch), in memory-mapped scratch files so
+that maps larger than physical memory can be paged in on demand.  Whole-map routines
+should loop over the columns returned by column<float>() or column<double>();
+the indexing operator[] returns a MapPixel that points into the columns, so
+that we can still write
 
-A bunch of inlined syntax sugar so we can write 
 map2[i].T() = map1[j].T()
 
+On a const map operator[] returns a copy of the pixel instead, which leaves
+the map and its cached statistics alone; read-only callers should index a
+const Skymap.
+
+A map may be sparse, storing only its observed pixels.  The columns then hold
+n() entries for the pixels listed, in ascending order, by pixels(); npix() is
+the number of pixels on the full sky.  Columns, value() and operator[] are
+always indexed by entry; pixel() gives the pixel number of an entry and find()
+the entry of a pixel number.  For a dense map the two are the same.
+
+Pixels flagged as missing in a FITS file are stored as zero and marked invalid
+in a validity mask, one bit per entry.  Whole-map routines should only visit
+the valid entries, using forValid(), which passes each run of valid entries
+to a function.  The mask is empty when every entry is valid.
+
+The statistics of each column are computed on first request by stats() and
+kept until the map is modified.  Anything that may change the values or the
+mask--the non-const column(), setValue(), setValid(), operator[], or
+reallocating the columns--drops the cached statistics.  The cache is not
+guarded, so stats() must not be called while another thread modifies the map.
+
 There are four functions that are used to read and write the FITS headers.  The
 two write routines exist to add keywords to the default headers.  These versions
 do nothing; child classes should overload them as needed.
@@ -47,48 +122,82 @@ class Skymap
 			TnobsPix, 	// Temperature and Number of observations
 			TPnobsPix 	// Temperature, Polarization and Number of observations
 		};
+		// The pixel fields, each stored as a column.  The order matches
+		// BasePixel::operator[].
+		enum Column {
+			TCol,		// Temperature/Stokes I
+			QCol,		// Stokes Q
+			UCol,		// Stokes U
+			NobsCol,	// Number of observations
+			PmagCol,	// Polarization magnitude
+			PangCol,	// Polarization angle
+			NumCols		// Number of columns
+		};
+		// The storage precision of the columns.
+		enum Precision {
+			Single,		// 32-bit floats
+			Double		// 64-bit doubles
+		};
+		// Where the columns are kept.
+		enum Storage {
+			Heap,		// Allocated from the heap
+			Scratch		// Memory-mapped, unlinked scratch files
+		};
+		// The statistics of the valid values of one column.
+		struct Stats
+		{
+			double n;			// The number of values
+			double mn, mx;		// The extremes
+			double mean;		// The mean
+			double m2;			// The sum of squared deviations from the mean
+
+			Stats () : n(0.0), mn(0.0), mx(0.0), mean(0.0), m2(0.0) {}
+			void merge (const Stats &o);
+			double amax () const;
+			double stddev (bool sample = true) const;
+		};
 
 	protected:
 		Type type_;						// The current data Type
-		unsigned int n_;				// The current number of pixels
-		TPixel       *tpix;				// When TPix, where to store data
-		TPPixel      *tppix;			// When PPix, where to store data
-		TnobsPixel   *tnobspix;			// When TnobsPix, where to store data
-		TPnobsPixel  *tpnobspix;		// When TPnobsPix, where to store data
+		PixIndex n_;					// The current number of pixels
+		Precision prec_;				// The storage precision of the columns
+		Storage stor_;					// Where new columns are allocated
+		void *col_[NumCols];			// The field columns; NULL if not stored
+		size_t colbytes_[NumCols];		// The size of each column in bytes
+		bool colmapped_[NumCols];		// True if the column is a mapped file
+		PixIndex *pixidx_;				// Sorted pixel numbers; NULL if dense
+		PixIndex npix_;					// Full-sky pixel count of a sparse map
+		bool sparseload_;				// Make read maps sparse if smaller
+		LoadProgress *progress_;		// Progress of a read; NULL if not watched
+		BitMask valid_;					// Valid entries; empty if all are
+		mutable Stats stats_[NumCols];	// Cached column statistics
+		mutable unsigned int statsok_;	// Bit c set if stats_[c] is current
+		mutable uint64_t gen_;			// Data generation; 0 until next asked for
 
 		TPnobsPixel   minpix;			// Minimum pixel values.
 		TPnobsPixel   maxpix;			// Maximum pixel values.
 		TPnobsPixel   avgpix;			// Mean pixel value.
 		TPnobsPixel   stdpix;			// Std. dev. of the mean.
 
-		// Dummy variable needed for completeness of returnnone()
-		static BasePixel basedummy;
-
 		// Set to zero size and no type
 		virtual void init();
 		// Allocate pixel memory.
-		virtual void allocPixMemory(unsigned int n_in, Type type_in);
+		virtual void allocPixMemory(PixIndex n_in, Type type_in);
 		// Free all heap memory.
 		virtual void freeMemory();
-
-		//------------------------------------------------------------------------
-		// Versions of base indexing function to return a reference into this map
-		// Used when the contents of the map are to be modified
-
-		// method to call to return a refernece to an indexed pixel
-		BasePixel& (Skymap::*returnfct)(unsigned int);
-		
-		// Index look-up method for when no data is allocated
-		BasePixel& returnnone(unsigned int i);
-		// Index look-up method for when type = TPix
-		BasePixel& returnTpix(unsigned int i);
-		// Index look-up method for when type = PPix
-		BasePixel& returnTPpix(unsigned int i);
-		// Index look-up method for when type = TnobsPix
-		BasePixel& returnTnobspix(unsigned int i);
-		// Index look-up method for when type = TPnobsPix
-		BasePixel& returnTPnobspix(unsigned int i);
-
+		// Allocate and release a single zeroed column.
+		void allocColumn (Column c, PixIndex n_in);
+		void freeColumn  (Column c);
+		// Take over the columns of another map of the same type.
+		void swapColumns (Skymap &imap);
+		// Compute the statistics of every column not cached.
+		void updateStats () const;
+		// Sparse map support.
+		bool observed (PixIndex i) const;
+		bool sparseSmaller (PixIndex nobs) const;
+		void gather (const PixIndex *src, const PixIndex *pix, PixIndex nkeep,
+		             PixIndex npix_in);
+		void sortPixels ();
 
 		// Functions to read/write the FITS headers.
 		void writeHdrDate (fitsfile *fptr);
@@ -96,18 +205,37 @@ class Skymap
 		virtual void writeFITSPrimaryHeader   (fitsfile *fptr);
 		virtual void readFITSExtensionHeader  (fitsfile *fptr);
 		virtual void writeFITSExtensionHeader (fitsfile *fptr);
+		// Read FITS columns into map columns.
+		struct FITSColumn
+		{
+			int    fcol;				// The FITS column number
+			Column c;					// The map column
+			bool   subst;				// Replace flagged values and mark them invalid
+			long long offset;			// Of the column in a row, to copy it raw; else -1
+		};
+		void readFITSColumns (fitsfile *fptr, const FITSColumn *cols, int ncols,
+		                      PixIndex numcol, PixIndex numrow, double bad,
+		                      ControlDialog *progwin);
+		template <class T>
+		int readFITSChunk (fitsfile *fptr, std::mutex *io, std::vector<unsigned char> &rowbuf,
+		                   long long width, const FITSColumn *cols, int ncols,
+		                   PixIndex first, PixIndex n, PixIndex numcol, double bad,
+		                   std::vector<PixIndex> &invalid, Stats *m);
+		void readFITSPixels (fitsfile *fptr, int fcol, PixIndex numpix);
+		void writeFITSColumn (fitsfile *fptr, int fcol, Column c, bool flag);
 	public:
 		// Create with no data and Type
 		Skymap();
 
-		// Create with a selected size and Type
-		Skymap(unsigned int n_in, Type type_in);
+		// Create with a selected size, Type, Precision and Storage
+		Skymap(PixIndex n_in, Type type_in, Precision prec_in = Double,
+		       Storage stor_in = Heap);
 
 		// Done, call freeMemory()
 		virtual ~Skymap();
 
 		// Fundamental method to set size and type of data
-		virtual void set(unsigned int n_in, Type type_in);
+		virtual void set(PixIndex n_in, Type type_in);
 
 		// Clear stored memory and reset state
 		virtual void clear() { set(0,none); }
@@ -116,19 +244,65 @@ class Skymap
 		void copy (Skymap &imap);
 
 		// Return the number of pixels
-		unsigned int size() const { return n_; }
+		PixIndex size() const { return n_; }
 
 		// Return the number of pixels
-		unsigned int n() const { return n_; }
+		PixIndex n() const { return n_; }
+
+		// Sparse storage.  size() counts the stored entries, npix() the sky.
+		bool sparse() const { return pixidx_ != 0; }
+		PixIndex npix() const { return (pixidx_ != 0) ? npix_ : n_; }
+		const PixIndex* pixels() const { return pixidx_; }
+		PixIndex pixel (PixIndex i) const { return (pixidx_ != 0) ? pixidx_[i] : i; }
+		PixIndex find (PixIndex pix) const;
+		bool makeSparse (bool whenSmaller = false);
+		virtual void makeDense ();
+		bool sparseLoad () const { return sparseload_; }
+		void setSparseLoad (bool b) { sparseload_ = b; }
+		LoadProgress *loadProgress () const { return progress_; }
+		void setLoadProgress (LoadProgress *p) { progress_ = p; }
+
+		// Validity of the entries.
+		bool valid (PixIndex i) const { return valid_.empty() || valid_.test(i); }
+		bool allValid () const { return valid_.empty(); }
+		void setValid (PixIndex i, bool b);
+		PixIndex numValid () const { return valid_.empty() ? n_ : valid_.count(); }
+		template <class F> void forValid (F f) const { forValid(0, n_, f); }
+		template <class F> void forValid (PixIndex b, PixIndex e, F f) const;
 
 		// Return the type of data stored at each pixel
 		Type type() const { return type_; }
 		bool has_Temperature (void) const;
 		bool has_Polarization (void) const;
 		bool has_Nobs (void) const;
+
+		// Which columns a Type stores, and which column holds a display Field.
+		static bool typeHasColumn (Type t, Column c);
+		static Column fieldColumn (Field f);
+
+		// The storage precision; changing it converts any stored data.
+		Precision precision() const { return prec_; }
+		void setPrecision (Precision prec_in);
+		static Precision precisionOf (const float*)  { return Single; }
+		static Precision precisionOf (const double*) { return Double; }
+		unsigned int valueSize() const;
+
+		// Where the columns are kept; changing it moves any stored data.
+		Storage storage() const { return stor_; }
+		void setStorage (Storage stor_in);
+
+		// Contiguous access to the field columns.  T must match precision().
+		bool has_Column (Column c) const { return col_[c] != 0; }
+		template <class T> T*       column (Column c);
+		template <class T> const T* column (Column c) const;
+
+		// Single value access, in either precision.
+		double value (Column c, PixIndex i) const;
+		void   setValue (Column c, PixIndex i, double v);
 		
-		// Basic function to access a pixel
-		BasePixel& operator[](unsigned int i);
+		// Basic function to access a pixel, and a copy of one.
+		MapPixel operator[](PixIndex i);
+		MapPixel operator[](PixIndex i) const;
 		
 		// Copy operator.
 		Skymap& operator= (Skymap &imap);
@@ -136,6 +310,18 @@ class Skymap
 		// Compute the polarization magnitude and angle for each pixel.
 		virtual void computePolar (void);
 
+		// Cached statistics of a column, and dropping the cache.
+		const Stats& stats (Column c) const;
+		void invalidateStats () { statsok_ = 0; gen_ = 0; }
+
+		// A number that changes whenever the map's data may have changed.
+		uint64_t generation () const;
+
+		// Quantiles (0 to 1) of the valid values of a column.
+		void quantiles (Column c, int nq, const double *q, double *val,
+		                bool exact = true) const;
+		double quantile (Column c, double q, bool exact = true) const;
+
 		// Compute and return statistics on the map.
 		virtual void calcStats (void);
 		
@@ -185,11 +371,6 @@ class Skymap
 		virtual void writeFITS (std::string filename, char* tabname = NULL);
 		virtual void writeFITS (QString filename, char* tabname = NULL);
 };
-//----------------------------------------------------------------------------------
-inline BasePixel& Skymap::returnTpix(unsigned int i)       { return tpix[i]; }
-inline BasePixel& Skymap::returnTPpix(unsigned int i)      { return tppix[i]; }
-inline BasePixel& Skymap::returnTnobspix(unsigned int i)   { return tnobspix[i]; }
-inline BasePixel& Skymap::returnTPnobspix(unsigned int i)  { return tpnobspix[i]; }
 /* ----------------------------------------------------------------------------
 'has_Temperature' returns true if the map contains Stokes I/temperature data.
 
@@ -230,19 +411,214 @@ inline bool Skymap::has_Nobs (void) const
 	return ((type() == TnobsPix) || (type() == TPnobsPix));
 }
 /* ----------------------------------------------------------------------------
+'typeHasColumn' reports whether a map of a given Type stores a column.
+
+Static function.
+
+Arguments:
+	t - The map type.
+	c - The column.
+
+Returned:
+	true if the column is stored.
+---------------------------------------------------------------------------- */
+inline bool Skymap::typeHasColumn (Type t, Column c)
+{
+	switch (c)
+	{
+		case TCol:
+			return (t != none);
+		case QCol:
+		case UCol:
+		case PmagCol:
+		case PangCol:
+			return ((t == PPix) || (t == TPnobsPix));
+		case NobsCol:
+			return ((t == TnobsPix) || (t == TPnobsPix));
+		default:
+			break;
+	}
+	return false;
+}
+/* ----------------------------------------------------------------------------
+'fieldColumn' returns the column holding a display field.
+
+Static function.
+
+Arguments:
+	f - The display field.
+
+Returned:
+	The column.
+---------------------------------------------------------------------------- */
+inline Skymap::Column Skymap::fieldColumn (Field f)
+{
+	switch (f)
+	{
+		case Q:    return QCol;
+		case U:    return UCol;
+		case P:    return PmagCol;
+		case Nobs: return NobsCol;
+		case I:
+		default:   break;
+	}
+	return TCol;
+}
+/* ----------------------------------------------------------------------------
+'valueSize' returns the size in bytes of one stored value.
+
+Arguments:
+	None.
+
+Returned:
+	sizeof(float) or sizeof(double), according to the precision.
+---------------------------------------------------------------------------- */
+inline unsigned int Skymap::valueSize (void) const
+{
+	return (prec_ == Single) ? sizeof(float) : sizeof(double);
+}
+/* ----------------------------------------------------------------------------
+'column' returns the contiguous storage of one field of the map.  The template
+argument must be float for a Single map and double for a Double map.  The
+non-const version drops the cached statistics, so read-only loops should go
+through a const map.
+
+Arguments:
+	c  -  The column.
+
+Returned:
+	A pointer to the n() values of the column.  An exception is thrown if the
+	map does not store the column or if T does not match the precision.
+---------------------------------------------------------------------------- */
+template <class T> inline T* Skymap::column (Column c)
+{
+	if (col_[c] == 0) throw MapException(MapException::Undefined);
+	if (precisionOf((T*) 0) != prec_) throw MapException(MapException::InvalidType);
+	invalidateStats();
+	return static_cast<T*>(col_[c]);
+}
+template <class T> inline const T* Skymap::column (Column c) const
+{
+	if (col_[c] == 0) throw MapException(MapException::Undefined);
+	if (precisionOf((T*) 0) != prec_) throw MapException(MapException::InvalidType);
+	return static_cast<const T*>(col_[c]);
+}
+/* ----------------------------------------------------------------------------
+'value' returns one value of a column, widened to double.  'setValue' stores
+one.  These are meant for occasional access; whole-map routines should use
+column().
+
+Arguments:
+	c  -  The column.
+	i  -  The index into the column.  It is not checked.
+	v  -  The value to store.
+
+Returned:
+	The value.  An exception is thrown if the map does not store the column.
+---------------------------------------------------------------------------- */
+inline double Skymap::value (Column c, PixIndex i) const
+{
+	if (col_[c] == 0) throw MapException(MapException::Undefined);
+	if (prec_ == Single) return static_cast<const float*>(col_[c])[i];
+	return static_cast<const double*>(col_[c])[i];
+}
+inline void Skymap::setValue (Column c, PixIndex i, double v)
+{
+	if (col_[c] == 0) throw MapException(MapException::Undefined);
+	invalidateStats();
+	if (prec_ == Single) static_cast<float*>(col_[c])[i] = float(v);
+	                else static_cast<double*>(col_[c])[i] = v;
+}
+/* ----------------------------------------------------------------------------
+'setValid' marks an entry valid or invalid.  The mask is created when the
+first entry is marked invalid.
+
+Arguments:
+	i  -  The entry.  It is not checked.
+	b  -  true if the entry is valid.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+inline void Skymap::setValid (PixIndex i, bool b)
+{
+	invalidateStats();
+	if (valid_.empty())
+	{
+		if (b) return;
+		valid_.resize(n_, true);
+	}
+	valid_.set(i, b);
+}
+/* ----------------------------------------------------------------------------
+'forValid' calls a function for each run of consecutive valid entries among
+the entries first to last - 1 (by default, all of them).
+
+Arguments:
+	first -  The first entry to consider.
+	last  -  One past the last entry to consider.
+	f     -  The function, called as f(begin, end) for the entries begin to
+	         end - 1.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+template <class F> inline void Skymap::forValid (PixIndex first, PixIndex last, F f) const
+{
+	if (! valid_.empty()) valid_.forRuns(first, last, f);
+	else if (first < last) f(first, last);
+}
+/* ----------------------------------------------------------------------------
+'quantile' returns one quantile of the valid values of a column; see
+quantiles().
+
+Arguments:
+	c     -  The column.
+	q     -  The quantile, from 0 to 1.
+	exact -  false for the approximate, single-pass mode.  Defaults to true.
+
+Returned:
+	The value.
+---------------------------------------------------------------------------- */
+inline double Skymap::quantile (Column c, double q, bool exact) const
+{
+	double v;
+	quantiles(c, 1, &q, &v, exact);
+	return v;
+}
+/* ----------------------------------------------------------------------------
 'operator[]' allows the sky map to be indexed as an array.
 
 Arguments:
 	i  -  The index into the map.
 
 Returned:
-	A reference to the pixel is returned.  An exception is thrown if the index is out of
-	bounds.
+	A view of the pixel is returned.  An exception is thrown if the index is
+	out of bounds or the map is empty.
+---------------------------------------------------------------------------- */
+inline MapPixel Skymap::operator[](PixIndex i)
+{ 
+	if (type_ == none) throw MapException(MapException::InvalidType);
+	if ((i < 0) || (i >= n_)) throw MapException(MapException::Bounds);
+	invalidateStats();
+	return MapPixel(col_, prec_ == Single, i); 
+}
+/* ----------------------------------------------------------------------------
+'operator[]' returns a copy of a pixel of a const map.  The map is not
+changed, so its cached statistics are kept.
+
+Arguments:
+	i  -  The index into the map.
+
+Returned:
+	The pixel's values.  An exception is thrown if the index is out of bounds
+	or the map is empty.
 ---------------------------------------------------------------------------- */
-inline BasePixel& Skymap::operator[](unsigned int i)
+inline MapPixel Skymap::operator[](PixIndex i) const
 { 
-	if (i >= n_) throw MapException(MapException::Bounds);
-	return (this->*returnfct)(i); 
+	if (type_ == none) throw MapException(MapException::InvalidType);
+	if ((i < 0) || (i >= n_)) throw MapException(MapException::Bounds);
+	return MapPixel(static_cast<const void * const *>(col_), prec_ == Single, i); 
 }
 /* ----------------------------------------------------------------------------
 'operator=' copies another map into this one using the assignment operator.
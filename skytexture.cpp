@@ -4,13 +4,25 @@ usable by the QGLViewer.
 
 Written by Nicholas Phillips.
 QT4 implementation.  Michael R. Greason, ADNET, 29 December 2006.
+Packed RGBA color lookup.
+Texture filled by a pool of threads.
+Display values cached in texture order.
+Optional palette-indexed texture.
+Tiled, level-of-detail texture for large maps.
+Changed texels sent once a frame.
+Compact lookup tables built in parallel, in a bounded cache.
 ============================================================================ */
 /*
 			Fetch header files.
 */
 
+#include <string.h>
+#include <algorithm>
+#include <limits>
 #include "skytexture.h"
 #include "rangecontrol.h"
+#include "colortable.h"
+#include "parallel.h"
 #include "heal.h"
 #include "map_exception.h"
 
@@ -26,10 +38,13 @@ Arguments:
 Written by Nicholas Phillips.
 QT4 implementation.  Michael R. Greason, ADNET, 28 August 2007.
 ---------------------------------------------------------------------------- */
-SkyTexture::SkyTexture() : texture(0), texture_res(0), nside(0)
+SkyTexture::SkyTexture() : texture(0), texture_res(0), texel_bytes(4), index_bytes(0),
+                           nside(0), lut(0), painted(false), valuesgen(0), tiled(false),
+                           pyramidfield(-1), tilesready(false), tilesstale(false),
+                           tileside(0), tileflat(false), restart(false), update(false),
+                           sending(false), wholedirty(false), uploader(&gluploader)
 {
-	hilite_level = 128;
-	select_level =  64;
+	tileeye[0] = tileeye[1] = tileeye[2] = 0.;
 	order = HealpixMap::Undefined;
 	timer = new QTimer(this);
 	timer->setInterval(50);
@@ -52,11 +67,18 @@ SkyTexture::~SkyTexture()
 
 }
 /* ----------------------------------------------------------------------------
-'buildLUT' builds the lookup table for a given map size and pixel ordering.
+'buildLUT' builds the lookup table for a given map size and pixel ordering:
+the texel of each pixel, as an offset into the texture.
+
+The table is filled in NESTED order by a pool of threads, each taking a
+contiguous run of NESTED pixel numbers.  A pixel's position within its base
+face is the de-interleaved bits of its number within the face; for RING
+ordering the RING number is then worked out from the position directly.
 
 Arguments:
 	ns       - The desired nside.
 	ordering - The pixel ordering.
+	table    - The table to fill.
 
 Returned:
 	res      - Success?  true=yes.
@@ -64,61 +86,103 @@ Returned:
 Written by Nicholas Phillips.
 QT4 implementation.  Michael R. Greason, ADNET, 28 August 2007.
 ---------------------------------------------------------------------------- */
-bool SkyTexture::buildLUT(const int ns, HealpixMap::PixOrder ordering)
+bool SkyTexture::buildLUT(const int ns, HealpixMap::PixOrder ordering, PixLUT &table)
 {
 	if (ordering == HealpixMap::Undefined) return false;
-	PixLUTCache &lut_cache = (ordering == HealpixMap::Ring)
-	                       ? lut_cache_ring : lut_cache_nest;
-	PixLUT &lut = lut_cache[ns];
-	lut.resize(12*ns*ns);
-	int  face = 0, x = 0, y = 0;
-	long dy = 4*ns;
-	long pix;
-	long k = 0;
-	for(face = 0; face < 12; face++) {
-		long xo = ns*(face % 4);
-		long yo = ns*(face / 4);
-		long face_offset = face*ns*ns;
-		for(y = 0; y < ns; y++) {
-			for(x = 0; x < ns; x++) {
-				k = x + xo + (y+yo)*dy;
-				pix = xy2pix(x,y)  + face_offset;
-				if (ordering == HealpixMap::Ring)
-					nest2ring(ns,pix,&pix);
-				lut[pix] = 4*k;
+	// Texel offsets must fit the table's 32 bits.
+	if (ns <= 0 || 16*uint64_t(ns)*ns > (uint64_t(1) << 32)) return false;
+	const PixIndex area = PixIndex(ns)*ns;
+	table.resize(12*area);
+	uint32_t *out = table.data();
+	const bool ring = (ordering == HealpixMap::Ring);
+	const uint32_t dy = 4*ns;
+	parallelFor(12*area, 1 << 16, [=](unsigned int, PixIndex b, PixIndex e) {
+		for(PixIndex p = b; p < e; ) {
+			const int face = int(p / area);
+			const uint32_t xo = ns*(face % 4);
+			const uint32_t yo = ns*(face / 4);
+			const PixIndex face_offset = face*area;
+			const PixIndex last = std::min(e, face_offset + area);
+			for( ; p < last; p++) {
+				uint32_t x, y;
+				TilePyramid::unnest(uint64_t(p - face_offset), x, y);
+				const uint32_t k = x + xo + (y + yo)*dy;
+				if (ring)
+					out[xyf2ring(ns, x, y, face)] = k;
+				else
+					out[p] = k;
 			}
 		}
-	}
+	});
 	return true;
 }
 /* ----------------------------------------------------------------------------
 'getLUT' returns the lookup table for a given map size and pixel ordering.  If
-the table isn't defined, create it.
+the table isn't defined, create it.  The tables are kept, most recently used
+first, while together they take no more than lutCacheBytes; the one returned
+is always kept.
 
 Arguments:
 	nside_   - The desired nside.
 	ordering - The pixel ordering.
 
 Returned:
-	luti     - The lookup table.
+	lut      - The lookup table.
 
 Written by Nicholas Phillips.
 QT4 implementation.  Michael R. Greason, ADNET, 28 August 2007.
 ---------------------------------------------------------------------------- */
-PixLUTCache::iterator SkyTexture::getLUT(const int ns, HealpixMap::PixOrder ordering)
+PixLUT &SkyTexture::getLUT(const int ns, HealpixMap::PixOrder ordering)
 {
-	PixLUTCache::iterator luti;
-	if (ordering == HealpixMap::Undefined) return luti;
-	PixLUTCache &lut_cache = (ordering == HealpixMap::Ring)
-	                       ? lut_cache_ring : lut_cache_nest;
-
-	luti = lut_cache.find(ns);
-	if( luti == lut_cache.end() ) buildLUT(ns, ordering);
-	luti = lut_cache.find(ns);
-	if( luti == lut_cache.end() ) {
+	PixLUTCache::iterator luti = lut_cache.begin();
+	while( luti != lut_cache.end()
+	    && (luti->nside != ns || luti->order != ordering) ) ++luti;
+	if( luti != lut_cache.end() ) {
+		lut_cache.splice(lut_cache.begin(), lut_cache, luti);
+		return lut_cache.front().lut;
+	}
+/*
+			Make room for the new table, then build it.
+*/
+	size_t bytes = 12*size_t(ns)*ns*sizeof(PixLUT::value_type);
+	for(luti = lut_cache.begin(); luti != lut_cache.end(); ++luti) {
+		bytes += luti->lut.size()*sizeof(PixLUT::value_type);
+	}
+	while( ! lut_cache.empty() && bytes > lutCacheBytes ) {
+		bytes -= lut_cache.back().lut.size()*sizeof(PixLUT::value_type);
+		lut_cache.pop_back();
+	}
+	PixLUTEntry entry;
+	entry.nside = ns;
+	entry.order = ordering;
+	lut_cache.push_front(entry);
+	if( ! buildLUT(ns, ordering, lut_cache.front().lut) ) {
+		lut_cache.pop_front();
 		throw MapException(MapException::Other, 0, "SkyTexture::getLUT:Failed, aborting.");
 	}
-	return luti;
+	return lut_cache.front().lut;
+}
+/* ----------------------------------------------------------------------------
+'setIndexed' chooses how the texture is kept.  By default it is an RGBA image,
+four bytes a texel.  An indexed texture instead keeps one palette index per
+texel, 8 bits indexing a 256-color palette or 16 bits indexing a 4096-color
+palette, with the last color of the palette the gray of invalid pixels.  It
+takes a quarter or a half of the memory, and a change of color table only
+replaces the palette; the index image is not repainted.  The palette is
+applied as the texture is sent to GL, through GL's color-index pixel maps if
+the palette fits in them, and otherwise by expanding a strip of rows at a
+time.  The choice takes effect at the next set().
+
+Arguments:
+	bits - 0 for an RGBA texture, 8 or 16 for an indexed one.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SkyTexture::setIndexed(int bits)
+{
+	index_bytes = (bits >= 16) ? 2 : ((bits > 0) ? 1 : 0);
+	return;
 }
 /* ----------------------------------------------------------------------------
 'set' fills the texture from a skymap and the state of the range dialog.
@@ -148,15 +212,32 @@ void SkyTexture::set(HealpixMap *skymap_in, RangeControl *rangedialog)
 */
 	skymap = skymap_in;
 	order = skymap->pixordenum();
-	lut = &(getLUT(skymap->nside(), skymap->pixordenum())->second);
+	tiled = skymap->nside() > (unsigned int) tiledNside;
+	if( ! tiled )
+		lut = &getLUT(skymap->nside(), skymap->pixordenum());
+/*
+			Drop the cached display values if the map has changed.
+*/
+	if( skymap->generation() != valuesgen ) {
+		values.clear();
+		valuesgen = skymap->generation();
+		painted = false;
+		pyramidfield = -1;
+	}
 /*
-			Make sure texture buffer is correct size
+			Make sure texture buffer is correct size.  A tiled
+			texture has none; its tiles are RGBA.
 */
-	if( skymap->nside() != (unsigned int) nside ) {
+	int nbytes = (index_bytes > 0 && ! tiled) ? index_bytes : 4;
+	if( skymap->nside() != (unsigned int) nside || nbytes != texel_bytes
+	 || (texture == 0) != tiled ) {
 		nside = skymap->nside();
 		texture_res = 4*nside;
+		texel_bytes = nbytes;
 		if( texture) delete[] texture;
-		texture = new unsigned char[texture_res*texture_res*4];
+		texture = tiled ? 0
+		        : new unsigned char[size_t(texture_res)*texture_res*texel_bytes];
+		painted = false;
 	}
 /*
 			Retrieve the color table, the minimum and maximum, and the 
@@ -167,19 +248,80 @@ void SkyTexture::set(HealpixMap *skymap_in, RangeControl *rangedialog)
 	dpyfield = rangedialog->getField();
 	minv = rangedialog->getMinimum();
 	maxv = rangedialog->getMaximum();
+	stretch = rangedialog->getTransfer();
+/*
+			Fold the stretch and the color table into one packed
+			table, and the display range into the scale and offset
+			that turn a value into an index into it; the offset
+			includes the 0.5 that rounds to the nearest entry.
+			Invalid pixels get the gray at the end of the table.
+			An indexed texture instead folds the stretch into a
+			table of palette indices, so the palette holds the
+			color table alone, evenly resampled.
+*/
+	const vector<uint32_t> &packed = ct->getPacked();
+	const int top = ColorTable::packedSize - 1;
+	const unsigned char gray[4] = {128, 128, 128, 255};
+	if( texel_bytes == 4 ) {
+		rgba.resize(ColorTable::packedSize + 1);
+		for(int i = 0; i <= top; i++)
+			rgba[i] = packed[int(stretch(float(i) / top) * top + 0.5f)];
+		memcpy(&rgba[top + 1], gray, sizeof(gray));
+	}
+	else {
+		const int ptop = ((texel_bytes == 1) ? 256 : 4096) - 2;
+		palette.resize(ptop + 2);
+		for(int i = 0; i <= ptop; i++)
+			palette[i] = packed[int(float(i) / ptop * top + 0.5f)];
+		memcpy(&palette[ptop + 1], gray, sizeof(gray));
+		levels.resize(ColorTable::packedSize + 1);
+		for(int i = 0; i <= top; i++)
+			levels[i] = uint16_t(stretch(float(i) / top) * ptop + 0.5f);
+		levels[top + 1] = uint16_t(ptop + 1);
+	}
+	scale  = (maxv > minv) ? top / (maxv - minv) : 0.;
+	offset = 0.5 - minv * scale;
+/*
+			An indexed texture whose indices are still good only
+			needs the new palette sent to GL.
+*/
+	sending = true;
+	timer->start();	// no harm if already running
+	if( texel_bytes != 4 && painted && paintfield == dpyfield
+	 && paintmin == minv && paintmax == maxv
+	 && paintstretch == stretch.getStretch() ) return;
+/*
+			A tiled texture only needs its resident tiles colored
+			afresh, unless the pyramid is of another field.
+*/
+	tilesstale = true;
+	if( tiled && pyramidfield == dpyfield ) return;
+	tilesready = false;
 /*
 			Start the construction the color table.
 */
+	painted = false;
+	paintfield = dpyfield;
+	paintmin = minv;
+	paintmax = maxv;
+	paintstretch = stretch.getStretch();
 	restart = false;
 	update = true;
-	timer->start();	// no harm if already running
 	start();
 
 	return;
 }
 
 /* ----------------------------------------------------------------------------
-'run' fills the texture from a skymap, as a separate thread from the GUI
+'run' fills the texture from a skymap, as a separate thread from the GUI.  The
+values of the displayed field are first gathered into texture order, unless
+they already were for an earlier texture of the same map; the texture is then
+painted from them.  A change of range, stretch or color table thus only
+repaints, and switching back to a field already shown does not read the map.
+For a tiled texture the values are instead averaged, in NESTED order,
+straight from the map into the first level of the tile pyramid that is kept,
+and the coarser levels averaged from that; tiles are colored as they are
+drawn, those of the finest level from the map's column.
 
 
 Arguments:
@@ -192,45 +334,256 @@ Written by Nicholas Phillips.
 ---------------------------------------------------------------------------- */
 void SkyTexture::run()
 {
-	float v = 0.0;
-	long texk = 0;
-	QColor color, blank(255, 255, 255, 255);
-	for(uint pix = 0; pix < skymap->size(); pix++) {
-		switch (dpyfield)
-		{
-			case Nobs :			// N Obs
-				v = (*skymap)[pix].Nobs();
-				break;
-			case P :			// P Polarization
-				v = (*skymap)[pix].Pmag();
-				break;
-			case U :			// U Polarization
-				v = (*skymap)[pix].U();
-				break;
-			case Q :			// Q Polarization
-				v = (*skymap)[pix].Q();
-				break;
-			case I :			// Temperature
-				v = (*skymap)[pix].T();
-				break;
+	// Read through a const map so the map's cached statistics are kept.
+	const Skymap *map = skymap;
+	Skymap::Column c = Skymap::fieldColumn(dpyfield);
+	if( tiled ) {
+		pyramid.resize(nside);
+		bool done = (map->precision() == Skymap::Single)
+		          ? averageFinest(map->column<float>(c))
+		          : averageFinest(map->column<double>(c));
+		if( ! done ) {
+			pyramidfield = -1;
+			return;
 		}
-		
-		if (v < minv) v = minv;
-		if (v > maxv) v = maxv;
-		v = (v-minv)/(maxv-minv);
-		color = (*ct)(v);
-		texk = (*lut)[pix];
-		texture[texk++] = color.red();
-		texture[texk++] = color.green();
-		texture[texk++] = color.blue();
-		texture[texk++] = 255;
-		if( restart ) {return;}
+		pyramid.build();
+		pyramidfield = dpyfield;
+		tilesready = true;
+		update = false;
+		return;
+	}
+	vector<float> &buf = values[dpyfield];
+	if( buf.empty() ) {
+		const uint32_t *plut = lut->data();
+		auto place = [plut](PixIndex pix) { return PixIndex(plut[pix]); };
+		buf.resize(12*size_t(nside)*nside);
+		bool done = (map->precision() == Skymap::Single)
+		          ? gather(map->column<float>(c), buf.data(), place)
+		          : gather(map->column<double>(c), buf.data(), place);
+		if( ! done ) {
+			values.erase(dpyfield);
+			return;
+		}
+	}
+	bool done;
+	if( texel_bytes == 4 )
+		done = paint(buf.data(), rgba.data(), reinterpret_cast<uint32_t *>(texture));
+	else if( texel_bytes == 1 )
+		done = paint(buf.data(), levels.data(), texture);
+	else
+		done = paint(buf.data(), levels.data(), reinterpret_cast<uint16_t *>(texture));
+	if( done ) {
+		painted = true;
+		update = false;
 	}
-	update = false;
 	return;
 }
 /* ----------------------------------------------------------------------------
-'glTexture' assigns the texture to the OpenGL system.
+'gather' copies one column of the skymap into a buffer of display values.  The
+value of each pixel is stored at a position given by a function of the pixel,
+the position of its texel.  The twelve base faces fill the first
+12 nside^2 texels of the texture, so that is the length of the buffer.  Invalid pixels are stored as NaN, and so, for a sparse map, are
+the pixels that are not stored:  they were flagged missing or never observed,
+so they are drawn in the invalid-pixel gray rather than in the color of zero,
+which is a real data value.
+
+The map entries are split among a pool of threads in contiguous ranges.  Each
+pixel has its own texel, so the threads never write the same value.  In a
+nested map each HealPix base face is one contiguous range of pixels, and any
+range within it is a union of square sub-blocks of the face's nside x nside
+block of the texture, so each thread writes its own compact region.  The
+threads watch 'restart' between blocks of pixels and all give up once it is
+set.
+
+Arguments:
+	col   - The column to display, at the map's precision.
+	buf   - The 12 nside^2 display values.
+	place - The position in buf of a pixel, called as place(pix).
+
+Returned:
+	true if the buffer was completed, false if it was interrupted.
+
+Written by Nicholas Phillips.
+---------------------------------------------------------------------------- */
+template <class T, class P>
+bool SkyTexture::gather(const T *col, float *buf, P place)
+{
+	// Blocks of pixels between tests of 'restart', and the fewest pixels
+	// worth a thread.
+	const PixIndex block = 1 << 16;
+	const PixIndex grain = 1 << 16;
+	const Skymap *map = skymap;
+	const PixIndex *pixels = map->pixels();
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	if( pixels != 0 ) {
+		parallelFor(map->npix(), grain, [&](unsigned int, PixIndex b, PixIndex e) {
+			std::fill(buf + b, buf + e, nan);
+		});
+	}
+	auto invalid = [&](PixIndex b, PixIndex e) {
+		for(PixIndex k = b; k < e; k++)
+			buf[place((pixels != 0) ? pixels[k] : k)] = nan;
+	};
+	parallelFor(map->size(), grain, [&](unsigned int, PixIndex first, PixIndex last) {
+		PixIndex next = first;
+		bool stopped = false;
+		map->forValid(first, last, [&](PixIndex b, PixIndex e) {
+			if( stopped ) return;
+			invalid(next, b);
+			for(PixIndex k0 = b; k0 < e; k0 += block) {
+				PixIndex k1 = std::min(e, k0 + block);
+				if( pixels != 0 )
+					for(PixIndex k = k0; k < k1; k++)
+						buf[place(pixels[k])] = float(col[k]);
+				else
+					for(PixIndex k = k0; k < k1; k++)
+						buf[place(k)] = float(col[k]);
+				if( restart.load(std::memory_order_relaxed) ) {stopped = true; return;}
+			}
+			next = e;
+		});
+		if( ! stopped ) invalid(next, last);
+	});
+	return ! restart;
+}
+/* ----------------------------------------------------------------------------
+'finestEntry' finds the map entry holding a pixel of the finest level of the
+tile pyramid:  its number in the map's ordering, or, in a sparse map, the
+entry listing that number.
+
+Arguments:
+	nest - The pixel's NESTED number.
+
+Returned:
+	The entry, or -1 if a sparse map does not store the pixel.
+---------------------------------------------------------------------------- */
+PixIndex SkyTexture::finestEntry(PixIndex nest) const
+{
+	PixIndex pix = nest;
+	if( order == HealpixMap::Ring ) {
+		hpint64 ring;
+		nest2ring64(hpint64(nside), nest, &ring);
+		pix = PixIndex(ring);
+	}
+	return (skymap->pixels() != 0) ? skymap->find(pix) : pix;
+}
+/* ----------------------------------------------------------------------------
+'averageFinest' fills the first level of the tile pyramid that is kept, each
+value the mean of the four pixels of the map below it that are valid; the
+finest level itself is never copied out of the map.  A full-sky map is read
+pixel by pixel in NESTED order, through the ordering; a sparse map, whose
+stored pixels are few, has its entries summed one by one into the level and
+then divided by their counts.  Either way the work stops once 'restart' is
+set.
+
+Arguments:
+	col - The column to display, at the map's precision.
+
+Returned:
+	true if the level was completed, false if it was interrupted.
+---------------------------------------------------------------------------- */
+template <class T>
+bool SkyTexture::averageFinest(const T *col)
+{
+	const Skymap *map = skymap;
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	finestEntry(0);		// any tables are set up before the threads start
+	if( map->pixels() == 0 ) {
+		return pyramid.average([&](PixIndex nest) {
+			PixIndex k = finestEntry(nest);
+			return map->valid(k) ? float(col[k]) : nan;
+		}, restart);
+	}
+
+	const PixIndex n1 = 3*PixIndex(nside)*nside;	// 12 (nside/2)^2
+	const PixIndex *pixels = map->pixels();
+	float *sum = pyramid.values(1);
+	vector<uint8_t> count(size_t(n1), 0);
+	std::fill(sum, sum + n1, 0.f);
+	const hpint64 ns = nside;
+	bool stopped = false;
+	map->forValid(0, map->size(), [&](PixIndex b, PixIndex e) {
+		if( stopped || restart ) {stopped = true; return;}
+		for(PixIndex k = b; k < e; k++) {
+			hpint64 nest = pixels[k];
+			if( order == HealpixMap::Ring ) ring2nest64(ns, pixels[k], &nest);
+			sum[nest/4] += float(col[k]);
+			count[nest/4]++;
+		}
+	});
+	if( stopped ) return false;
+	parallelFor(n1, 1 << 16, [&](unsigned int, PixIndex b, PixIndex e) {
+		for(PixIndex j = b; j < e; j++)
+			sum[j] = (count[j] > 0) ? sum[j] / count[j] : nan;
+	});
+	return ! restart;
+}
+/* ----------------------------------------------------------------------------
+'finestTile' reads the values of a tile of the finest level of the pyramid
+from the map's column into 'tilevalues', NaN for the pixels that are invalid
+or not stored.
+
+Arguments:
+	col   - The column on display, at the map's precision.
+	first - The NESTED number of the tile's first pixel.
+	n     - The number of values in the tile.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+template <class T>
+void SkyTexture::finestTile(const T *col, PixIndex first, PixIndex n)
+{
+	const Skymap *map = skymap;
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	tilevalues.resize(size_t(n));
+	for(PixIndex j = 0; j < n; j++) {
+		PixIndex k = finestEntry(first + j);
+		tilevalues[j] = ((k >= 0) && map->valid(k)) ? float(col[k]) : nan;
+	}
+}
+/* ----------------------------------------------------------------------------
+'paint' colors the texture from a buffer of display values in texture order,
+in one linear pass split among a pool of threads.  Each value is turned into
+an index into a table by one multiply and add, and the table entry, a packed
+RGBA color or a palette index, is stored as the texel.  NaN, an invalid pixel,
+fails both comparisons and takes the gray at the end of the table.
+
+Arguments:
+	buf   - The 12 nside^2 display values, from gather.
+	table - The colors or palette indices of the scaled values, 'rgba' or
+	        'levels'.
+	out   - The texels.
+
+Returned:
+	true if the texture was completed, false if it was interrupted.
+
+Written by Nicholas Phillips.
+---------------------------------------------------------------------------- */
+template <class L, class W>
+bool SkyTexture::paint(const float *buf, const L *table, W *out)
+{
+	const int top = ColorTable::packedSize - 1;
+	const float sc = scale, off = offset;
+	const PixIndex block = 1 << 16;
+	const PixIndex grain = 1 << 16;
+	parallelFor(12*PixIndex(nside)*nside, grain, [&](unsigned int, PixIndex b, PixIndex e) {
+		for(PixIndex k0 = b; k0 < e; k0 += block) {
+			PixIndex k1 = std::min(e, k0 + block);
+			for(PixIndex k = k0; k < k1; k++) {
+				float x = buf[k] * sc + off;
+				int i = (x > 0) ? ((x < top) ? int(x) : top) : ((x <= 0) ? 0 : top + 1);
+				out[k] = W(table[i]);
+			}
+			if( restart.load(std::memory_order_relaxed) ) return;
+		}
+	});
+	return ! restart;
+}
+/* ----------------------------------------------------------------------------
+'reTexture' is called by the timer while the texture is being painted.  It
+marks the whole texture to be sent at the next flush and asks the viewer to
+draw; once the painting is done it does so one last time and stops the timer.
 
 Arguments:
 	None.
@@ -242,42 +595,254 @@ Written by Nicholas Phillips.
 ---------------------------------------------------------------------------- */
 void SkyTexture::reTexture()
 {
-	glTexture();
-	emit retextured();
-	/*
-	if( ! update )
+	if( ! sending ) {
 		timer->stop();
-	*/
+		return;
+	}
+	sending = update;	// read before sending, so the last paint is sent
+	wholedirty = true;
+	emit retextured();
 	return;
 }
+/* ----------------------------------------------------------------------------
+'glTexture' assigns the texture to the OpenGL system.  An indexed texture is
+expanded through its palette on the way:  by GL's color-index pixel maps when
+the palette fits in them, and otherwise a strip of rows at a time, so that no
+full RGBA copy is made.  The texture must be bound and the GL context
+current; flush() calls it when the whole texture is due.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+
+Written by Nicholas Phillips.
+---------------------------------------------------------------------------- */
 void SkyTexture::glTexture()
 {
-	glTexImage2D(
-		GL_TEXTURE_2D, 0, 4,
-		texture_res, texture_res, 0,
-		GL_RGBA, GL_UNSIGNED_BYTE,
-		texture
-	);
+	if( tiled ) return;	// tiles are sent as they are drawn
+	if( texel_bytes == 4 ) {
+		uploader->image(texture_res, texture_res, GL_RGBA, GL_UNSIGNED_BYTE, texture);
+		return;
+	}
+	const GLsizei npal = GLsizei(palette.size());
+	GLint maxmap = 0;
+	glGetIntegerv(GL_MAX_PIXEL_MAP_TABLE, &maxmap);
+	if( npal <= maxmap ) {
+		vector<GLfloat> chan(4*size_t(npal));
+		for(GLsizei i = 0; i < npal; i++) {
+			const unsigned char *c = reinterpret_cast<const unsigned char *>(&palette[i]);
+			for(int j = 0; j < 4; j++) chan[j*npal + i] = c[j] / 255.f;
+		}
+		glPixelMapfv(GL_PIXEL_MAP_I_TO_R, npal, &chan[0]);
+		glPixelMapfv(GL_PIXEL_MAP_I_TO_G, npal, &chan[npal]);
+		glPixelMapfv(GL_PIXEL_MAP_I_TO_B, npal, &chan[2*npal]);
+		glPixelMapfv(GL_PIXEL_MAP_I_TO_A, npal, &chan[3*npal]);
+		uploader->image(texture_res, texture_res, GL_COLOR_INDEX,
+		                (texel_bytes == 1) ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT, texture);
+	}
+	else {
+		uploader->image(texture_res, texture_res, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		// Only the first three quarters of the rows hold faces.
+		const int rows = std::max(1, 65536 / texture_res);
+		vector<uint32_t> strip(size_t(rows)*texture_res);
+		const uint16_t *idx16 = reinterpret_cast<const uint16_t *>(texture);
+		for(int y0 = 0; y0 < 3*nside; y0 += rows) {
+			int ny = std::min(rows, 3*nside - y0);
+			PixIndex k0 = PixIndex(y0)*texture_res;
+			for(PixIndex k = 0; k < PixIndex(ny)*texture_res; k++)
+				strip[k] = palette[(texel_bytes == 1) ? texture[k0 + k] : idx16[k0 + k]];
+			uploader->subImage(TexRect(0, y0, texture_res, ny), texture_res, &strip[0]);
+		}
+	}
 	return;
 }
 /* ----------------------------------------------------------------------------
-'highlite' highlights a pixel by setting its transparency.
+'setUploader' sets what sends the texture's texels to GL.
 
 Arguments:
-	pix   - The pixel to tweak.
-	alpha - The opacity of the pixel.  1 indicates opaque; 0 indicates
-	        transparent.
+	u - The uploader, which the texture does not own, or null for the one
+	    that calls GL.
 
 Returned:
 	Nothing.
+---------------------------------------------------------------------------- */
+void SkyTexture::setUploader(TexUploader *u)
+{
+	uploader = (u != 0) ? u : &gluploader;
+	return;
+}
+/* ----------------------------------------------------------------------------
+'flush' sends the whole texture if it has been painted since the last flush.
+The viewer calls it once a frame, before drawing, with the texture bound and
+the GL context current.  Tiles are sent as they are drawn instead.
 
-Written by Nicholas Phillips.
+Arguments:
+	None.
+
+Returned:
+	Nothing.
 ---------------------------------------------------------------------------- */
-void SkyTexture::highlite (const int pix, float alpha)
+void SkyTexture::flush()
 {
-	long texk = (*lut)[pix];
-	if (alpha < 0.) alpha = 0.;
-	if (alpha > 1.) alpha = 1.;
-	texture[texk+3] = int(255. * alpha);
+	if( tiled || texture == 0 || ! wholedirty ) return;
+	wholedirty = false;
 	glTexture();
+	return;
+}
+/* ----------------------------------------------------------------------------
+'colorOf' returns the packed color of a display value, as 'paint' finds it.
+
+Arguments:
+	v - The value; NaN for an invalid pixel.
+
+Returned:
+	The packed RGBA color.
+---------------------------------------------------------------------------- */
+inline uint32_t SkyTexture::colorOf(float v) const
+{
+	const int top = ColorTable::packedSize - 1;
+	float x = v * scale + offset;
+	return rgba[(x > 0) ? ((x < top) ? int(x) : top) : ((x <= 0) ? 0 : top + 1)];
+}
+/* ----------------------------------------------------------------------------
+'setTileView' tells a tiled texture what the view needs:  the detail, as the
+number of values a face side should show, and where the view is from, so
+that tiles on the far side of the sphere are neither colored nor sent.  The
+viewer calls it before each draw.
+
+Arguments:
+	side - The values a face side should show.
+	eye  - The viewpoint, in the coordinates of the rigging.
+	flat - true if the map is flat, as in the Mollweide projection, so that
+	       all of it faces the viewer.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SkyTexture::setTileView(int side, const float *eye, bool flat)
+{
+	tileside = side;
+	for(int i = 0; i < 3; i++) tileeye[i] = eye[i];
+	tileflat = flat;
+	return;
+}
+/* ----------------------------------------------------------------------------
+'tileLevel' returns the pyramid level drawn for the current view.  Only
+called once the pyramid is complete.
+
+Arguments:
+	None.
+
+Returned:
+	The level; 0 is the finest.
+---------------------------------------------------------------------------- */
+int SkyTexture::tileLevel() const
+{
+	return pyramid.levelFor(tileside);
+}
+/* ----------------------------------------------------------------------------
+'tilesPerSide' returns the number of tiles a face side is cut into at the
+level drawn.
+
+Arguments:
+	None.
+
+Returned:
+	The number of tiles, or 0 if there is nothing to draw yet.
+---------------------------------------------------------------------------- */
+int SkyTexture::tilesPerSide() const
+{
+	if( ! tiled || ! tilesready ) return 0;
+	return pyramid.tilesPerSide(tileLevel());
+}
+/* ----------------------------------------------------------------------------
+'facing' tells whether a point of the rigging is seen from the viewpoint:  a
+point p of the sphere is on the near side if p.eye > p.p.
+
+Arguments:
+	x,y,z - The point.
+
+Returned:
+	true if the point can be seen.
+---------------------------------------------------------------------------- */
+bool SkyTexture::facing(float x, float y, float z) const
+{
+	if( tileflat ) return true;
+	return x*tileeye[0] + y*tileeye[1] + z*tileeye[2] > x*x + y*y + z*z;
+}
+/* ----------------------------------------------------------------------------
+'bindTile' makes a tile of the current level the current GL texture, coloring
+it and sending it to GL if it is not resident.  Sending a tile may evict the
+least recently drawn one.  Resident tiles are dropped first if the colors or
+range have changed since they were sent.  A tile of the finest level is read
+from the map, which must not change while it is drawn.  Must be called with
+the GL context current.
+
+Arguments:
+	face  - The HealPix base face.
+	tx,ty - The tile's column and row in the face.
+
+Returned:
+	true if the tile is bound; false if there is nothing to draw yet.
+---------------------------------------------------------------------------- */
+bool SkyTexture::bindTile(int face, int tx, int ty)
+{
+	if( ! tiled || ! tilesready ) return false;
+	if( tilesstale ) {
+		releaseTiles();
+		tilesstale = false;
+	}
+	TileKey k(tileLevel(), face, tx, ty);
+	GLuint name;
+	if( tilecache.find(k, name) ) {
+		glBindTexture(GL_TEXTURE_2D, name);
+		return true;
+	}
+/*
+			Color the tile and send it.
+*/
+	const int ts = pyramid.tileSideAt(k.level);
+	auto color = [this](float v) { return colorOf(v); };
+	tileimage.resize(size_t(ts)*ts);
+	if( k.level == 0 ) {
+		const Skymap *map = skymap;
+		Skymap::Column c = Skymap::fieldColumn(Field(pyramidfield));
+		if( map->precision() == Skymap::Single )
+			finestTile(map->column<float>(c), pyramid.firstPixel(k), PixIndex(ts)*ts);
+		else
+			finestTile(map->column<double>(c), pyramid.firstPixel(k), PixIndex(ts)*ts);
+		TilePyramid::paintValues(&tilevalues[0], ts, color, &tileimage[0]);
+	}
+	else
+		pyramid.paintTile(k, color, &tileimage[0]);
+	glGenTextures(1, &name);
+	glBindTexture(GL_TEXTURE_2D, name);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	uploader->image(ts, ts, GL_RGBA, GL_UNSIGNED_BYTE, &tileimage[0]);
+	vector<unsigned int> evicted;
+	tilecache.insert(k, name, evicted);
+	if( ! evicted.empty() ) glDeleteTextures(GLsizei(evicted.size()), &evicted[0]);
+	return true;
+}
+/* ----------------------------------------------------------------------------
+'releaseTiles' deletes every resident tile from GL.  Must be called with the
+GL context current.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void SkyTexture::releaseTiles()
+{
+	vector<unsigned int> evicted;
+	tilecache.clear(evicted);
+	if( ! evicted.empty() ) glDeleteTextures(GLsizei(evicted.size()), &evicted[0]);
+	return;
 }
@@ -6,57 +6,124 @@ usable by the QGLViewer.
 
 Written by Nicholas Phillips.
 QT4 implementation.  Michael R. Greason, ADNET, 29 December 2006.
+Packed RGBA color lookup.
+Texture filled by a pool of threads.
+Display values cached in texture order.
+Optional palette-indexed texture.
+Tiled, level-of-detail texture for large maps.
+Changed texels sent once a frame.
+Compact lookup tables built in parallel, in a bounded cache.
 ============================================================================ */
 /*
 			Fetch header files.
 */
 #include <vector>
+#include <list>
 #include <map>
+#include <atomic>
 #include <qtimer.h>
 #include <qthread.h>
 #include <QGLViewer/qglviewer.h>
 #include "healpixmap.h"
 #include "enums.h"
+#include "stretch.h"
+#include "tiles.h"
+#include "texupload.h"
 
 class ColorTable;
 class RangeControl;
 /*
 			Typedefs.
 */
-typedef std::vector<long> PixLUT;			// Skymap->texture lookup table.
-typedef std::map<int, PixLUT > PixLUTCache; 		// Cache of computed texture look-up
-							// tables.
+typedef std::vector<uint32_t> PixLUT;		// Skymap->texture lookup table:  the
+							// texel of each pixel.
+struct PixLUTEntry					// A lookup table with its nside
+{							// and ordering.
+	int nside;
+	HealpixMap::PixOrder order;
+	PixLUT lut;
+};
+typedef std::list<PixLUTEntry> PixLUTCache;		// Cache of computed texture look-up
+							// tables, most recently used first.
 
 /* ============================================================================
 'SkyTexture' defines the interface that converts a skymap into a texture
 usable by the QGLViewer.
+
+Maps finer than tiledNside are not made into one texture, which would exceed
+the size GL allows, but into a pyramid of display values from which the
+viewer draws tiles at the level of detail the view needs, each tile colored
+and sent to GL when first drawn and kept while it is among the most recently
+drawn.  The tiles of the finest level are read from the map's column, which
+the pyramid does not copy.
+
+Nothing is sent to GL as the texture is painted; flush() sends a new or
+repainted texture whole, once a frame, as the viewer draws.  The selection
+is not marked in the texture but drawn over it; see SelectionOverlay.
 ============================================================================ */
-class SkyTexture : public QThread
+class SkyTexture : public QThread, public TileBinder
 {
 	Q_OBJECT
 private:
-	unsigned char  hilite_level;
-	unsigned char  select_level;
 	unsigned char *texture;			// Texture representation of skymap
 	int            texture_res;		// Resolution per side of texture
+	int            texel_bytes;		// Bytes per texel of 'texture': 4 for RGBA,
+						// 1 or 2 for palette indices
+	int            index_bytes;		// Bytes per palette index asked for; 0 for RGBA
 	int            nside;			// HealPix resolution parameter for texture.
 	HealpixMap::PixOrder order; 		// The HealPix ordering scheme.
 	PixLUT        *lut;			// Pointer to current look-up table
-	PixLUTCache    lut_cache_ring;		// Cache of ring-ordered look-up tables
-	PixLUTCache    lut_cache_nest;		// Cache of nest-ordered look-up tables
+	PixLUTCache    lut_cache;		// Cache of look-up tables
 	HealpixMap *skymap;				// Skymap to use
 	ColorTable *ct;				// The color table to use
-	int    dpyfieldold;			// The display fiels to use
 	Field  dpyfield;			// The display fiels to use
 	double minv;				// The minimum display value
 	double maxv;				// The maximum display value
-	bool restart;				// set when current repaint should stop
+	StretchTable stretch;			// The color stretch
+	std::vector<uint32_t> rgba;		// Stretch and color table as packed RGBA;
+						// the last entry is the invalid-pixel gray
+	std::vector<uint16_t> levels;		// Indexed: the stretched palette index of
+						// each entry of 'rgba'
+	std::vector<uint32_t> palette;		// Indexed: packed RGBA color of each index;
+						// the last is the invalid-pixel gray
+	bool   painted;				// Indexed: texture matches the keys below
+	int    paintfield;			// Field,...
+	double paintmin, paintmax;		// ...range...
+	Stretch paintstretch;			// ...and stretch last painted
+	std::map<int, std::vector<float> > values;	// Display values in texture order, by field
+	uint64_t valuesgen;			// Map generation the values were read from
+	float  scale;				// Display value to rgba index: scale...
+	float  offset;				// ...and offset
+	bool   tiled;				// Drawn from tiles of 'pyramid'
+	TilePyramid pyramid;			// Tiled: averages of the display values
+	int    pyramidfield;			// Tiled: field in 'pyramid', or -1
+	std::atomic<bool> tilesready;		// Tiled: 'pyramid' is complete
+	bool   tilesstale;			// Tiled: resident tiles have old colors
+	TileCache tilecache;			// Tiled: tiles resident in GL
+	std::vector<uint32_t> tileimage;	// Tiled: a tile being colored
+	std::vector<float> tilevalues;		// Tiled: the values of a finest tile
+	int    tileside;			// Tiled: values a face side should show
+	float  tileeye[3];			// Tiled: the viewpoint...
+	bool   tileflat;			// ...and whether the map is flat
+	std::atomic<bool> restart;		// set when current repaint should stop
 
 	QTimer *timer;				// Controls how often to update GL
-	bool update;				// true while there is still a need to update
+	std::atomic<bool> update;		// true while the texture is being painted
+	bool sending;				// the texture is to be sent at each timer tick
+	bool wholedirty;			// the whole texture is to be sent at the next flush
+	TexUploader *uploader;			// sends texels to GL
+	GLTexUploader gluploader;		// the default uploader
 
-	bool buildLUT(const int ns, HealpixMap::PixOrder ordering);
-	PixLUTCache::iterator getLUT(const int ns, HealpixMap::PixOrder ordering);
+	bool buildLUT(const int ns, HealpixMap::PixOrder ordering, PixLUT &table);
+	template <class T, class P> bool gather(const T *col, float *buf, P place);
+	template <class L, class W> bool paint(const float *buf, const L *table, W *out);
+	PixIndex finestEntry(PixIndex nest) const;
+	template <class T> bool averageFinest(const T *col);
+	template <class T> void finestTile(const T *col, PixIndex first, PixIndex n);
+	uint32_t colorOf(float v) const;
+	int tileLevel() const;
+	void releaseTiles();
+	PixLUT &getLUT(const int ns, HealpixMap::PixOrder ordering);
 
 protected:
 	void run();
@@ -68,10 +135,22 @@ public :
 	SkyTexture();
 	virtual ~SkyTexture();
 
+	static const int tiledNside = 1024;	// Finest map drawn as one texture
+	static const size_t lutCacheBytes = 64 << 20;	// Most bytes of look-up tables kept
+
 	void set(HealpixMap *skymap, RangeControl *rangecontrol);
+	void setIndexed(int bits);
+	bool isTiled() const { return tiled; }
+
+	// The view, for the choice of tiles, and the TileBinder interface.
+	void setTileView(int side, const float *eye, bool flat);
+	int tilesPerSide() const;
+	bool facing(float x, float y, float z) const;
+	bool bindTile(int face, int tx, int ty);
 
+	void setUploader(TexUploader *u);
 	void glTexture();
-	void highlite (const int pix, float alpha = 1.);
+	void flush();
 
 signals:
 	void retextured();			// emitted every time the texture is sent to GL
@@ -38,7 +38,7 @@ SkyViewer::SkyViewer (QWidget *parent, mainWindow *mw) :
 	mwin      = mw;
 	texture   = NULL;
 	rigging   = NULL;
-	whiterig  = NULL;
+	overlay   = NULL;
 	polar     = NULL;
 	hlite     =  1.0;
 	delhlite  = -0.1;
@@ -60,7 +60,7 @@ SkyViewer::~SkyViewer()
 	saveStateToFile();
 	texture  = NULL;
 	rigging  = NULL;
-	whiterig = NULL;
+	overlay  = NULL;
 	polar    = NULL;
 	if (constraint != NULL) delete constraint;
 	constraint = NULL;
@@ -148,6 +148,9 @@ void SkyViewer::init(void)
 }
 /* ----------------------------------------------------------------------------
 'draw' is called the whenever the widget needs to be drawn on the screen.
+Any changes to the texture since the last frame are sent to GL first.  The
+selected pixels are drawn over the map, pulsing between the map and white or
+black as 'animate' steps the opacity.
 
 Arguments:
 	None.
@@ -167,24 +170,28 @@ void SkyViewer::draw(void)
 	if (showtex) {
 		bool sr = showrigging;
 		showrigging = false;
-		if (whiterig != NULL)
+		if (rigging != NULL)
 		{
-			glDisable(GL_TEXTURE_2D);
-			if (pulseflg)
+			glColor4f(1., 1., 1., 1.);
+			if (texture != NULL)
 			{
-				glColor4f(whitecolor.redF(), whitecolor.greenF(), whitecolor.blueF(), 1.);
+				glEnable( GL_TEXTURE_2D );
+				texture->flush();
 			}
-			else
+			if ((texture != NULL) && texture->isTiled())
 			{
-				glColor4f(blackcolor.redF(), blackcolor.greenF(), blackcolor.blueF(), 1.);
+				setTileView();
+				rigging->draw(texture);
+				glBindTexture(GL_TEXTURE_2D, 0);
 			}
-			whiterig->draw();
+			else
+				rigging->draw();
 		}
-		if (rigging != NULL)
+		if ((overlay != NULL) && ! overlay->empty())
 		{
-			glColor4f(1., 1., 1., 1.);
-			if (texture != NULL) glEnable( GL_TEXTURE_2D );
-			rigging->draw();
+			glDisable(GL_TEXTURE_2D);
+			const QColor &c = pulseflg ? whitecolor : blackcolor;
+			overlay->draw(c.redF(), c.greenF(), c.blueF(), 1. - hlite);
 		}
 		showrigging = sr;
 	}
@@ -194,6 +201,28 @@ void SkyViewer::draw(void)
 	}
 }
 /* ----------------------------------------------------------------------------
+'setTileView' tells a tiled texture how much detail the view needs and where
+it is seen from.  The detail is the number of screen pixels across a unit
+length at the nearest point of the map, the sphere's surface or the plane of
+the Mollweide projection; a face is about a unit across.
+
+Arguments:
+	None.
+
+Returned:
+	None.
+---------------------------------------------------------------------------- */
+void SkyViewer::setTileView (void)
+{
+	Vec eye = camera()->position();
+	bool flat = rigging->mollweide();
+	double dist = flat ? fabs(eye.x) : eye.norm() - 1.;
+	if (dist < 0.01) dist = 0.01;
+	double perunit = height() / (2. * dist * tan(0.5 * camera()->fieldOfView()));
+	float e[3] = { float(eye.x), float(eye.y), float(eye.z) };
+	texture->setTileView(int(perunit), e, flat);
+}
+/* ----------------------------------------------------------------------------
 'animate' is called to perform the next step in animating the viewer.
 
 Arguments:
@@ -220,7 +249,6 @@ void SkyViewer::animate (void)
 		delhlite = -delhlite;
 		pulseflg = pulseflg ? false : true;
 	}
-	mwin->highlightPixels(hlite);
 }
 /* ----------------------------------------------------------------------------
 'postSelection' is called at the end of the selection process by the QGLViewer
@@ -15,6 +15,7 @@ QT4 implementation.  Michael R. Greason, ADNET, 29 December 2006.
 #include "skytexture.h"
 #include "rigging.h"
 #include "polarargline.h"
+#include "overlay.h"
 
 class mainWindow;
 /* ============================================================================
@@ -33,7 +34,7 @@ protected:
 
 	SkyTexture      *texture;
 	Rigging         *rigging;
-	Rigging         *whiterig;
+	SelectionOverlay *overlay;
 	PolarArgLineSet *polar;
 
 	QColor whitecolor, blackcolor;
@@ -44,6 +45,7 @@ protected:
 	virtual void init(void);
 	virtual void draw(void);
 	virtual void animate (void);
+	void setTileView (void);
 
 	virtual void postSelection (const QPoint &pt);
 public :
@@ -52,7 +54,7 @@ public :
 
 	void setTexture      (SkyTexture      *t);
 	void setRigging      (Rigging         *r);
-	void setWhiteRigging (Rigging         *r);
+	void setOverlay      (SelectionOverlay *o);
 	void setPolarAngles  (PolarArgLineSet *p);
 
 	void constrainMollweide (bool b);
@@ -80,10 +82,10 @@ inline void SkyViewer::setRigging(Rigging *r)
 	rigging = r;
 }
 /* ----------------------------------------------------------------------------
-'setWhiteRigging' assigns the rigging of the underlying white image to be used.
+'setOverlay' assigns the layer that marks the selected pixels.
 
 Arguments:
-	r - The new rigging.
+	o - The overlay.
 
 Returned:
 	None.
@@ -91,9 +93,9 @@ Returned:
 Written by Nicholas Phillips.
 QT4 implementation.  Michael R. Greason, ADNET, 28 August 2007.
 ---------------------------------------------------------------------------- */
-inline void SkyViewer::setWhiteRigging(Rigging *r)
+inline void SkyViewer::setOverlay(SelectionOverlay *o)
 {
-	whiterig = r;
+	overlay = o;
 }
 /* ----------------------------------------------------------------------------
 'setPolarAngles' assigns the polarization angles to be displayed.
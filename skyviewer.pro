@@ -15,16 +15,23 @@ HEADERS += mainwindow.h \
            outlog.h \
            heal.h \
            pixel.h \
+           bitmask.h \
+           parallel.h \
            skymap.h \
            healpixmap.h \
+           maploader.h \
            colortable.h \
+           stretch.h \
            define_colortable.h \
            glpoint.h \
            face.h \
            boundary.h \
            rigging.h \
            skytexture.h \
+           tiles.h \
+           texupload.h \
            polarargline.h \
+           overlay.h \
            skyviewer.h \
            histogram.h \
            histoview.h \
@@ -43,12 +50,17 @@ SOURCES += main.cpp \
            pixel.cpp \
            skymap.cpp \
            healpixmap.cpp \
+           maploader.cpp \
            colortable.cpp \
+           stretch.cpp \
            face.cpp \
            boundary.cpp \
            rigging.cpp \
            skytexture.cpp \
+           tiles.cpp \
+           texupload.cpp \
            polarargline.cpp \
+           overlay.cpp \
            skyviewer.cpp \
            histogram.cpp \
            histogramwidget.cpp \
@@ -0,0 +1,78 @@
+/* ============================================================================
+'stretch.cpp' defines the transfer table that applies a color stretch to the
+display values.  The class is defined in 'stretch.h'.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <math.h>
+#include "stretch.h"
+#include "histogram.h"
+
+using namespace std;
+/* ----------------------------------------------------------------------------
+'StretchTable' is the class constructor; it tabulates the linear stretch.
+
+Arguments:
+	None.
+---------------------------------------------------------------------------- */
+StretchTable::StretchTable()
+{
+	set(Linear);
+}
+/* ----------------------------------------------------------------------------
+'set' tabulates a stretch that does not depend on the data.  Equalize is
+tabulated as Linear; use the other form.
+
+Arguments:
+	s - The stretch.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void StretchTable::set(Stretch s)
+{
+	const double a = 1000., b = 10.;
+	stretch = s;
+	table.resize(size);
+	for (int i = 0; i < size; i++)
+	{
+		double x = double(i) / (size - 1), y;
+		switch (s)
+		{
+			case Log:   y = log(1. + a * x) / log(1. + a); break;
+			case Sqrt:  y = sqrt(x);                       break;
+			case Asinh: y = asinh(b * x) / asinh(b);       break;
+			case Linear:
+			case Equalize:
+			default:    y = x;                             break;
+		}
+		table[i] = float(y);
+	}
+}
+/* ----------------------------------------------------------------------------
+'set' tabulates a stretch, using the histogram of the map values for
+histogram equalization.
+
+Arguments:
+	s  - The stretch.
+	h  - The histogram.  If NULL, Equalize falls back to Linear.
+	x0 - The bottom of the selected range, as a 0--1 position along the
+	     histogram.
+	x1 - The top of the selected range, likewise.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void StretchTable::set(Stretch s, const Histogram *h, float x0, float x1)
+{
+	set(s);
+	if ((s != Equalize) || (h == 0) || (x1 <= x0)) return;
+	double c0 = h->fraction(x0), c1 = h->fraction(x1);
+	if (c1 <= c0) return;
+	for (int i = 0; i < size; i++)
+	{
+		float x = x0 + (x1 - x0) * i / (size - 1);
+		table[i] = float((h->fraction(x) - c0) / (c1 - c0));
+	}
+}
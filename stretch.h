@@ -0,0 +1,58 @@
+#ifndef STRETCH_H
+#define STRETCH_H
+/* ============================================================================
+'stretch.h' defines the transfer table that applies a color stretch to the
+display values.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <vector>
+#include "enums.h"
+
+class Histogram;
+/* ============================================================================
+'StretchTable' maps a display value, already scaled so that the selected range
+runs from 0 to 1, onto the 0--1 position in the color table.  The mapping is
+tabulated once when the stretch or range changes, so the texture kernel pays
+one table lookup per pixel whatever the stretch; no logarithms or square roots
+are taken per pixel.
+
+The stretches are:
+	Linear   - The identity.
+	Equalize - The cumulative distribution of the map values within the
+	           range, taken from the map's histogram, so that each color is
+	           used by about as many pixels.
+	Log      - log(1 + a x) / log(1 + a), with a = 1000.
+	Sqrt     - The square root.
+	Asinh    - asinh(b x) / asinh(b), with b = 10.
+============================================================================ */
+class StretchTable
+{
+public:
+	StretchTable();
+	void set(Stretch s);
+	void set(Stretch s, const Histogram *h, float x0, float x1);
+	Stretch getStretch() const { return stretch; }
+	float operator()(float x) const;
+protected:
+	static const int size = 4096;	//!< Number of table entries
+	Stretch stretch;		//!< The stretch tabulated
+	std::vector<float> table;	//!< The stretched values of 0--1
+};
+/* ----------------------------------------------------------------------------
+'operator()' applies the stretch.
+
+Arguments:
+	x - The scaled value; values outside 0--1 are clamped.
+
+Returned:
+	The position in the color table, 0--1.
+---------------------------------------------------------------------------- */
+inline float StretchTable::operator()(float x) const
+{
+	if (x <= 0.) return table[0];
+	if (x >= 1.) return table[size - 1];
+	return table[int(x * (size - 1) + 0.5f)];
+}
+#endif
@@ -0,0 +1,31 @@
+#ifndef CHECK_H
+#define CHECK_H
+/* ============================================================================
+'check.h' defines the checks the tests make.  A check that fails is reported
+with its file and line and counted, and the test goes on; a test's main
+returns checkResult(), nonzero if any check failed.
+============================================================================ */
+#include <stdio.h>
+
+inline int &checkFailures ()
+{
+	static int n = 0;
+	return n;
+}
+inline bool checkThat (bool ok, const char *what, const char *file, int line)
+{
+	if (! ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+		checkFailures()++;
+	}
+	return ok;
+}
+inline int checkResult (const char *name)
+{
+	if (checkFailures() == 0) printf("%s: all checks passed\n", name);
+	                     else printf("%s: %d checks failed\n", name, checkFailures());
+	return (checkFailures() == 0) ? 0 : 1;
+}
+#define CHECK(c) checkThat((c), #c, __FILE__, __LINE__)
+#endif
@@ -0,0 +1,4 @@
+# The FITS reader, threaded and serial.
+include(../maps.pri)
+TARGET = tst_fitsread
+SOURCES += tst_fitsread.cpp
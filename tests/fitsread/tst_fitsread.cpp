@@ -0,0 +1,167 @@
+/* ============================================================================
+'tst_fitsread.cpp' checks the FITS reader on a table of several chunks of
+rows:  a map read by a pool of threads must match the map read by one thread,
+entry for entry, and both must match the table as cfitsio reads it column by
+column.  The table is written here, with flagged and undefined values among
+the data, and removed afterwards.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <fitsio.h>
+#include "healpixmap.h"
+#include "parallel.h"
+#include "check.h"
+
+using namespace std;
+
+static const char *fileName = "tst_fitsread.fits";
+static const unsigned int nside = 64;
+static const long numcol = 1024;			// Entries per row
+static const double nullval = -1.6375e30;
+/* ----------------------------------------------------------------------------
+'writeTable' writes a NESTED map of I, Q, U and N_obs, numcol entries to a
+row.  Some I values carry the HEALPix flag and some Q values are NaN.
+
+Arguments:
+	None.
+
+Returned:
+	The number of rows cfitsio reads at once, or 0 if the table could not be
+	written.
+---------------------------------------------------------------------------- */
+static long writeTable ()
+{
+	char *ttype[] = { (char*)"TEMPERATURE", (char*)"Q_POLARISATION",
+	                  (char*)"U_POLARISATION", (char*)"N_OBS" };
+	char *tform[] = { (char*)"1024E", (char*)"1024E", (char*)"1024E", (char*)"1024J" };
+	char *tunit[] = { (char*)"mK", (char*)"mK", (char*)"mK", (char*)"counts" };
+	char  extname[] = "Sky Maps";
+	const PixIndex np = HealpixMap::NSide2NPix(nside);
+	vector<float> t(np), q(np), u(np);
+	vector<int>   n(np);
+	for (PixIndex i = 0; i < np; i++)
+	{
+		t[i] = float(100. * sin(0.01 * i));
+		q[i] = float(i % 211) - 105.f;
+		u[i] = float(cos(0.003 * i));
+		n[i] = int(i % 17);
+		if (i % 101 == 3) t[i] = float(nullval);
+		if (i % 103 == 5) q[i] = NAN;
+	}
+	fitsfile *fptr;
+	int  status = 0;
+	long rows = 0;
+	string name = string("!") + fileName;
+	fits_create_file(&fptr, name.c_str(), &status);
+	fits_create_img(fptr, SHORT_IMG, 0, NULL, &status);
+	fits_create_tbl(fptr, BINARY_TBL, 0, 4, ttype, tform, tunit, extname, &status);
+	fits_write_key(fptr, TSTRING, "ORDERING", (void*)"NESTED", NULL, &status);
+	int ns = int(nside);
+	fits_write_key(fptr, TINT, "NSIDE", &ns, NULL, &status);
+	fits_write_col(fptr, TFLOAT, 1, 1, 1, np, &t[0], &status);
+	fits_write_col(fptr, TFLOAT, 2, 1, 1, np, &q[0], &status);
+	fits_write_col(fptr, TFLOAT, 3, 1, 1, np, &u[0], &status);
+	fits_write_col(fptr, TINT,   4, 1, 1, np, &n[0], &status);
+	fits_get_rowsize(fptr, &rows, &status);
+	fits_close_file(fptr, &status);
+	return (status == 0) ? rows : 0;
+}
+/* ----------------------------------------------------------------------------
+'readMap' reads the table into a map split among a given number of threads.
+
+Arguments:
+	threads - The number of threads.
+	prec    - The map's precision.
+
+Returned:
+	The map.
+---------------------------------------------------------------------------- */
+static HealpixMap *readMap (unsigned int threads, Skymap::Precision prec)
+{
+	HealpixMap *m = new HealpixMap();
+	m->setPrecision(prec);
+	m->setSparseLoad(false);
+	setParallelThreads(threads);
+	m->readFITS(fileName, (ControlDialog*)NULL);
+	setParallelThreads(0);
+	return m;
+}
+/* ----------------------------------------------------------------------------
+'compare' checks a threaded read against a serial one, and both against the
+table read column by column.
+
+Arguments:
+	prec - The maps' precision.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+static void compare (Skymap::Precision prec)
+{
+	HealpixMap *serial = readMap(1, prec);
+	HealpixMap *pooled = readMap(4, prec);
+	const PixIndex np = HealpixMap::NSide2NPix(nside);
+	CHECK(serial->size() == np);
+	CHECK(pooled->size() == np);
+	CHECK(pooled->type() == Skymap::TPnobsPix);
+/*
+			The table as cfitsio reads it, at the map's precision.
+*/
+	fitsfile *fptr;
+	int status = 0, anynul = 0;
+	vector<double> col[4];
+	fits_open_file(&fptr, fileName, READONLY, &status);
+	fits_movabs_hdu(fptr, 2, NULL, &status);
+	for (int c = 0; c < 4; c++)
+	{
+		col[c].resize(np);
+		if (prec == Skymap::Single)
+		{
+			vector<float> f(np);
+			fits_read_col(fptr, TFLOAT, c + 1, 1, 1, np, NULL, &f[0], &anynul, &status);
+			for (PixIndex i = 0; i < np; i++) col[c][i] = f[i];
+		}
+		else
+			fits_read_col(fptr, TDOUBLE, c + 1, 1, 1, np, NULL, &col[c][0], &anynul, &status);
+	}
+	fits_close_file(fptr, &status);
+	CHECK(status == 0);
+
+	const Skymap::Column cols[4] = { Skymap::TCol, Skymap::QCol, Skymap::UCol,
+	                                 Skymap::NobsCol };
+	long bad = 0;
+	for (PixIndex i = 0; (i < np) && (bad < 10); i++)
+	{
+		bool flagged = false;
+		for (int c = 0; c < 3; c++)
+			if ((col[c][i] != col[c][i]) || (float(col[c][i]) == float(nullval)))
+				flagged = true;
+		bool ok = (pooled->valid(i) == serial->valid(i)) && (pooled->valid(i) == ! flagged);
+		for (int c = 0; c < 4; c++)
+		{
+			ok = ok && (pooled->value(cols[c], i) == serial->value(cols[c], i));
+			bool undefined = (col[c][i] != col[c][i]) || (float(col[c][i]) == float(nullval));
+			if (! undefined) ok = ok && (pooled->value(cols[c], i) == col[c][i]);
+		}
+		if (! CHECK(ok)) bad++;
+	}
+	const Skymap::Stats &a = serial->stats(Skymap::TCol), &b = pooled->stats(Skymap::TCol);
+	CHECK(a.n == b.n);
+	CHECK(fabs(a.mean - b.mean) <= 1e-9 * fabs(a.mean) + 1e-12);
+	delete serial;
+	delete pooled;
+}
+int main ()
+{
+	long rows = writeTable();
+	if (! CHECK(rows > 0)) return checkResult("fitsread");
+	CHECK(HealpixMap::NSide2NPix(nside) / numcol > 2 * rows);
+	compare(Skymap::Double);
+	compare(Skymap::Single);
+	remove(fileName);
+	return checkResult("fitsread");
+}
@@ -0,0 +1,45 @@
+# ============================================================================
+# The map classes, with the dialogs they report a load to and the classes
+# those dialogs use, for tests of the maps.
+# ============================================================================
+include(tests.pri)
+QT += core gui widgets xml opengl
+QMAKE_CXXFLAGS += -DTOASCII=toLatin1 -DFROMASCII=fromLatin1
+FORMS += $$SRC/histogramwidget.ui \
+         $$SRC/rangecontrol.ui \
+         $$SRC/controldialog.ui
+HEADERS += $$SRC/str_funcs.h \
+           $$SRC/map_exception.h \
+           $$SRC/heal.h \
+           $$SRC/pixel.h \
+           $$SRC/bitmask.h \
+           $$SRC/parallel.h \
+           $$SRC/skymap.h \
+           $$SRC/healpixmap.h \
+           $$SRC/colortable.h \
+           $$SRC/stretch.h \
+           $$SRC/define_colortable.h \
+           $$SRC/tiles.h \
+           $$SRC/histogram.h \
+           $$SRC/histoview.h \
+           $$SRC/histogramwidget.h \
+           $$SRC/enums.h \
+           $$SRC/rangecontrol.h \
+           $$SRC/controldialog.h \
+           $$SRC/selectedpixelmodel.h
+SOURCES += $$SRC/str_funcs.cpp \
+           $$SRC/map_exception.cpp \
+           $$SRC/heal.cpp \
+           $$SRC/pixel.cpp \
+           $$SRC/skymap.cpp \
+           $$SRC/healpixmap.cpp \
+           $$SRC/colortable.cpp \
+           $$SRC/stretch.cpp \
+           $$SRC/tiles.cpp \
+           $$SRC/histogram.cpp \
+           $$SRC/histogramwidget.cpp \
+           $$SRC/histoview.cpp \
+           $$SRC/rangecontrol.cpp \
+           $$SRC/controldialog.cpp \
+           $$SRC/selectedpixelmodel.cpp
+LIBS += -lchealpix -lcfitsio
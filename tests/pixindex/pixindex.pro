@@ -0,0 +1,4 @@
+# Pixel indices past 2^32.
+include(../maps.pri)
+TARGET = tst_pixindex
+SOURCES += tst_pixindex.cpp
@@ -0,0 +1,217 @@
+/* ============================================================================
+'tst_pixindex.cpp' checks that pixel indices past 2^32 survive the map code:
+the pixel counts of nside 16384 and 32768, the degrading and upgrading of
+indices, the look-up of the entries of a sparse map whose pixel numbers are
+that large, and the NESTED bit interleave of the tile pyramid.  The large maps
+are never allocated; the sparse map is made of a few synthetic entries.  A
+small map made sparse must keep its valid zeros and its pixel numbering.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <stdint.h>
+#include "healpixmap.h"
+#include "heal.h"
+#include "tiles.h"
+#include "check.h"
+
+static const PixIndex two32 = PixIndex(1) << 32;
+/* ============================================================================
+'Probe' is a map with the protected parts the checks need made reachable.
+============================================================================ */
+class Probe : public HealpixMap
+{
+public:
+	Probe (PixIndex n, PixOrder ord) : HealpixMap(n, TPix, ord) {}
+	using HealpixMap::degrade_pixindex;
+	void setPixels (const PixIndex *pix, PixIndex np);
+};
+/* ----------------------------------------------------------------------------
+'setPixels' makes the map sparse, its entries holding the given pixels of a
+sky of np pixels.
+
+Arguments:
+	pix - The pixel of each entry, in ascending order.
+	np  - The pixels of the whole sky.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void Probe::setPixels (const PixIndex *pix, PixIndex np)
+{
+	delete [] pixidx_;
+	pixidx_ = new PixIndex[size_t(size()) + 1];
+	for (PixIndex k = 0; k < size(); k++) pixidx_[k] = pix[k];
+	npix_ = np;
+}
+/* ----------------------------------------------------------------------------
+'pixelCounts' checks the pixel counts of the largest maps, which pass 2^31
+and 2^32, and the way back to nside.
+---------------------------------------------------------------------------- */
+static void pixelCounts ()
+{
+	CHECK(HealpixMap::NSide2NPix(16384) == PixIndex(3221225472LL));
+	CHECK(HealpixMap::NSide2NPix(32768) == PixIndex(12884901888LL));
+	CHECK(HealpixMap::Res2NPix(14) == HealpixMap::NSide2NPix(16384));
+	CHECK(HealpixMap::Res2NPix(15) == HealpixMap::NSide2NPix(32768));
+	CHECK(HealpixMap::NPix2NSide(HealpixMap::NSide2NPix(16384)) == 16384);
+	CHECK(HealpixMap::NPix2NSide(HealpixMap::NSide2NPix(32768)) == 32768);
+	CHECK(HealpixMap::NPix2Res(HealpixMap::NSide2NPix(32768)) == 15);
+}
+/* ----------------------------------------------------------------------------
+'degradeIndices' checks that pixels of nside 32768 find their parents at
+nside 16384 and coarser.  Upgrading takes each new pixel's values from the
+parent degrade_pixindex finds, so these are the indices an upgrade uses too.
+---------------------------------------------------------------------------- */
+static void degradeIndices ()
+{
+	const unsigned int hi = 32768, lo = 16384;
+	const PixIndex nhi = HealpixMap::NSide2NPix(hi), nlo = HealpixMap::NSide2NPix(lo);
+	Probe nest(12, HealpixMap::Nested);
+/*
+			In NESTED order the four children of pixel i are 4i to 4i + 3.
+*/
+	CHECK(nest.degrade_pixindex(nhi - 1, hi, lo) == nlo - 1);
+	CHECK(nest.degrade_pixindex(nhi - 1, hi, 128) == HealpixMap::NSide2NPix(128) - 1);
+	const PixIndex parents[] = { two32 / 4 - 1, two32 / 4, two32 / 4 + 3, two32 - 1,
+	                             two32, two32 + 12345, nlo - 1 };
+	for (PixIndex i : parents)
+	{
+		for (PixIndex c = 4*i; c < 4*i + 4; c++)
+			CHECK(nest.degrade_pixindex(c, hi, lo) == i);
+		if (i > 0) CHECK(nest.degrade_pixindex(4*i - 1, hi, lo) == i - 1);
+		CHECK(nest.degrade_pixindex(256*i + 255, 16*lo, lo) == i);
+	}
+/*
+			In RING order the first pixel is at the north pole and the last
+			at the south pole, at every resolution.
+*/
+	Probe ring(12, HealpixMap::Ring);
+	CHECK(ring.degrade_pixindex(0, hi, lo) == 0);
+	CHECK(ring.degrade_pixindex(nhi - 1, hi, lo) == nlo - 1);
+	for (PixIndex r : parents)
+	{
+		hpint64 n, p;
+		ring2nest64(hi, r, &n);
+		nest2ring64(lo, n / 4, &p);
+		CHECK(ring.degrade_pixindex(r, hi, lo) == PixIndex(p));
+	}
+}
+/* ----------------------------------------------------------------------------
+'upgradeMaps' checks that upgrading a small map gives each new pixel the
+value of its parent, in both orderings.
+---------------------------------------------------------------------------- */
+static void upgradeMaps ()
+{
+	const unsigned int lo = 2, hi = 8;
+	const HealpixMap::PixOrder orders[] = { HealpixMap::Nested, HealpixMap::Ring };
+	for (HealpixMap::PixOrder ord : orders)
+	{
+		HealpixMap m(HealpixMap::NSide2NPix(lo), Skymap::TPix, ord);
+		for (PixIndex i = 0; i < m.size(); i++) m.setValue(Skymap::TCol, i, double(i));
+		m.resize(hi);
+		CHECK(m.nside() == hi);
+		CHECK(m.size() == HealpixMap::NSide2NPix(hi));
+		for (PixIndex j = 0; j < m.size(); j++)
+		{
+			hpint64 n = j, p;
+			if (ord == HealpixMap::Ring) ring2nest64(hi, j, &n);
+			p = n / ((hi / lo) * (hi / lo));
+			if (ord == HealpixMap::Ring) nest2ring64(lo, p, &p);
+			if (! CHECK(m.value(Skymap::TCol, j) == double(p))) break;
+		}
+	}
+}
+/* ----------------------------------------------------------------------------
+'sparseLookup' checks that the entries of a sparse map holding pixels past
+2^32 of an nside 32768 sky are found from their pixel numbers and back.
+---------------------------------------------------------------------------- */
+static void sparseLookup ()
+{
+	const PixIndex np = HealpixMap::NSide2NPix(32768);
+	const PixIndex pix[] = { 17, two32 - 1, two32, two32 + 7, 2*two32 + 5, np - 1 };
+	const PixIndex n = PixIndex(sizeof(pix) / sizeof(pix[0]));
+	Probe s(n, HealpixMap::Nested);
+	s.setPixels(pix, np);
+	CHECK(s.sparse());
+	CHECK(s.size() == n);
+	CHECK(s.npix() == np);
+	for (PixIndex k = 0; k < n; k++)
+	{
+		CHECK(s.pixel(k) == pix[k]);
+		CHECK(s.find(pix[k]) == k);
+	}
+	CHECK(s.find(two32 + 1) == -1);
+	CHECK(s.find(two32 - 2) == -1);
+	CHECK(s.find(np) == -1);
+	CHECK(s.find(-1) == -1);
+}
+/* ----------------------------------------------------------------------------
+'sparseKeep' checks that making a map sparse drops only its invalid entries,
+or those with no observations, keeps a RING map's numbering, and that the
+dropped pixels come back invalid when the map is made dense again.
+---------------------------------------------------------------------------- */
+static void sparseKeep ()
+{
+	const unsigned int ns = 4;
+	const PixIndex np = HealpixMap::NSide2NPix(ns);
+	HealpixMap m(np, Skymap::TPix, HealpixMap::Ring);
+	for (PixIndex i = 0; i < np; i++)
+	{
+		m.setValue(Skymap::TCol, i, double(i % 3) - 1.0);
+		if ((i % 5) == 2) m.setValid(i, false);
+	}
+	CHECK(m.makeSparse());
+	CHECK(m.pixordenum() == HealpixMap::Ring);
+	CHECK(m.npix() == np);
+	CHECK(m.size() == np - np / 5 - ((np % 5) > 2));
+	for (PixIndex i = 0; i < np; i++)
+	{
+		PixIndex k = m.find(i);
+		if (! CHECK((k < 0) == ((i % 5) == 2))) break;
+		if ((k >= 0) && ! CHECK(m.value(Skymap::TCol, k) == double(i % 3) - 1.0)) break;
+	}
+	m.makeDense();
+	CHECK(m.size() == np);
+	for (PixIndex i = 0; i < np; i++)
+		if (! CHECK(m.valid(i) == ((i % 5) != 2))) break;
+
+	HealpixMap n(np, Skymap::TPnobsPix, HealpixMap::Nested);
+	for (PixIndex i = 0; i < np; i++) n.setValue(Skymap::NobsCol, i, double(i % 4));
+	CHECK(n.makeSparse());
+	CHECK(n.size() == np - np / 4);
+	CHECK(n.find(0) == -1);
+	CHECK(n.find(1) == 0);
+}
+/* ----------------------------------------------------------------------------
+'nestBits' checks that 32-bit coordinates interleave into a 64-bit NESTED
+index and back.
+---------------------------------------------------------------------------- */
+static void nestBits ()
+{
+	CHECK(TilePyramid::nest(1, 0) == 1);
+	CHECK(TilePyramid::nest(0, 1) == 2);
+	CHECK(TilePyramid::nest(0x80000000u, 0) == (uint64_t(1) << 62));
+	CHECK(TilePyramid::nest(0, 0x80000000u) == (uint64_t(1) << 63));
+	CHECK(TilePyramid::nest(0xffffffffu, 0xffffffffu) == ~uint64_t(0));
+	CHECK(TilePyramid::nest(0xffffffffu, 0) == 0x5555555555555555ULL);
+	uint32_t s = 12345;
+	for (int k = 0; k < 100000; k++)
+	{
+		uint32_t x = (s = s*1664525u + 1013904223u);
+		uint32_t y = (s = s*1664525u + 1013904223u);
+		uint32_t x2, y2;
+		TilePyramid::unnest(TilePyramid::nest(x, y), x2, y2);
+		if (! CHECK((x2 == x) && (y2 == y))) break;
+	}
+}
+int main ()
+{
+	pixelCounts();
+	degradeIndices();
+	upgradeMaps();
+	sparseLookup();
+	sparseKeep();
+	nestBits();
+	return checkResult("pixindex");
+}
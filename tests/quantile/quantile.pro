@@ -0,0 +1,4 @@
+# The quantiles of a map column, exact and approximate.
+include(../maps.pri)
+TARGET = tst_quantile
+SOURCES += tst_quantile.cpp
@@ -0,0 +1,106 @@
+/* ============================================================================
+'tst_quantile.cpp' checks the quantiles of a map column against the values
+nth_element picks out of a sorted copy of its valid entries:  exactly in the
+exact mode and to within 0.2% of the value's size in the approximate mode.
+The columns hold ties, negative values, invalid entries set to NaN, a bin of
+equal values too full to gather at once, and no valid entries at all.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "skymap.h"
+#include "check.h"
+
+using namespace std;
+
+static const double qs[] = { 0.0, 0.001, 0.01, 0.25, 0.5, 0.75, 0.99, 0.999, 1.0 };
+static const int nq = int(sizeof(qs) / sizeof(qs[0]));
+/* ----------------------------------------------------------------------------
+'reference' finds the quantiles of a set of values the plain way:  the value
+at rank q(n - 1), interpolated between the two nearest ranks, each picked out
+by nth_element.
+
+Arguments:
+	x   - The values.
+	val - Returned with the quantiles.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+static void reference (vector<double> x, double *val)
+{
+	const PixIndex n = PixIndex(x.size());
+	for (int i = 0; i < nq; i++)
+	{
+		double h = qs[i] * double(n - 1);
+		PixIndex k = PixIndex(h), k1 = min(k + 1, n - 1);
+		nth_element(x.begin(), x.begin() + k, x.end());
+		double lo = x[k];
+		nth_element(x.begin(), x.begin() + k1, x.end());
+		val[i] = lo + (h - double(k)) * (x[k1] - lo);
+	}
+}
+/* ----------------------------------------------------------------------------
+'compare' checks the quantiles of the temperature column of a map in both
+precisions and both modes.  The entries that 'value' marks with NaN are made
+invalid.
+
+Arguments:
+	name  - What the column holds, for the report.
+	n     - The number of entries.
+	value - The value of an entry, called as value(i).
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+template <class F>
+static void compare (const char *name, PixIndex n, F value)
+{
+	const Skymap::Precision precs[] = { Skymap::Single, Skymap::Double };
+	for (Skymap::Precision p : precs)
+	{
+		Skymap m(n, Skymap::TPix, p);
+		vector<double> x;
+		for (PixIndex i = 0; i < n; i++)
+		{
+			double v = value(i);
+			m.setValue(Skymap::TCol, i, v);
+			if (v != v) m.setValid(i, false);
+			else x.push_back(m.value(Skymap::TCol, i));
+		}
+		double want[nq], exact[nq], approx[nq];
+		if (x.empty()) for (int i = 0; i < nq; i++) want[i] = 0.0;
+		else reference(x, want);
+		const Skymap &c = m;
+		c.quantiles(Skymap::TCol, nq, qs, exact, true);
+		c.quantiles(Skymap::TCol, nq, qs, approx, false);
+		for (int i = 0; i < nq; i++)
+		{
+			if (! CHECK(exact[i] == want[i]))
+				fprintf(stderr, "  %s, q %g: %.17g, not %.17g\n", name, qs[i], exact[i], want[i]);
+			double tol = 0.002 * fabs(want[i]) + 1e-12 * c.stats(Skymap::TCol).amax();
+			if (! CHECK(fabs(approx[i] - want[i]) <= tol))
+				fprintf(stderr, "  %s, q %g approx: %.17g, not %.17g\n", name, qs[i], approx[i], want[i]);
+		}
+		CHECK(c.quantile(Skymap::TCol, 0.5) == exact[4]);
+	}
+}
+int main ()
+{
+	const double nan = NAN;
+	compare("smooth", 100001, [](PixIndex i) { return sin(0.001 * double(i)) * 50.0; });
+	compare("negative", 20000, [](PixIndex i) { return -1.0 - double(i % 977) * 0.25; });
+	compare("ties", 50000, [](PixIndex i) { return double(i % 7) - 3.0; });
+	compare("invalid", 30000, [nan](PixIndex i)
+	        { return (i % 13 == 0) ? nan : double((i * 7919) % 30011) - 15000.0; });
+	compare("bright", 40000, [](PixIndex i)
+	        { return (i % 1000 == 0) ? 1e6 + double(i) : 1e-3 * double(i % 101); });
+	compare("crowded", 6000000, [](PixIndex i)
+	        { return (i % 4 != 0) ? 1.0 + 1e-6 * double(i % 1000) : double(i % 11) - 5.0; });
+	compare("single", 1, [](PixIndex) { return 4.0; });
+	compare("empty", 500, [nan](PixIndex) { return nan; });
+	return checkResult("quantile");
+}
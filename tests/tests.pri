@@ -0,0 +1,25 @@
+# ============================================================================
+# Settings shared by the tests.  A test takes the viewer's sources it needs
+# from the directory above.
+# ============================================================================
+TEMPLATE = app
+CONFIG += console testcase warn_on thread c++11
+CONFIG -= app_bundle
+SRC = $$PWD/..
+INCLUDEPATH += $$SRC $$PWD
+DEPENDPATH += $$SRC $$PWD
+HEADERS += $$PWD/check.h
+QMAKE_CXXFLAGS += $$(CXXFLAGS)
+QMAKE_LFLAGS += $$(LDFLAGS)
+unix{
+  UI_DIR = ui
+  MOC_DIR = moc
+  OBJECTS_DIR = obj
+  isEmpty( PREFIX ){
+    PREFIX=/usr/local
+  }
+  isEmpty( LIB_DIR ){
+    LIB_DIR = $$PREFIX/lib
+  }
+  LIBS += -L$$LIB_DIR
+}
@@ -0,0 +1,16 @@
+# ============================================================================
+# The skyviewer tests.  Each is a console program, built against the viewer's
+# own sources, that prints the checks that fail and returns nonzero if any
+# do.  Build and run them all with:
+#
+#	cd tests
+#	qmake
+#	make
+#	make check
+# ============================================================================
+TEMPLATE = subdirs
+SUBDIRS = pixindex \
+          fitsread \
+          tiles \
+          upload \
+          quantile
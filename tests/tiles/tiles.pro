@@ -0,0 +1,10 @@
+# The tile pyramid's averaging and sizes, and the tile cache's evictions.
+include(../tests.pri)
+CONFIG -= qt
+TARGET = tst_tiles
+HEADERS += $$SRC/pixel.h \
+           $$SRC/map_exception.h \
+           $$SRC/parallel.h \
+           $$SRC/tiles.h
+SOURCES += $$SRC/tiles.cpp \
+           tst_tiles.cpp
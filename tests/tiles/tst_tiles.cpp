@@ -0,0 +1,167 @@
+/* ============================================================================
+'tst_tiles.cpp' checks the CPU side of the tiled sky texture:  the averaging
+of the tile pyramid, NaN and all, from a finest level it does not keep, the
+level and tile sizes where the faces grow smaller than a tile, and the order
+in which the tile cache evicts.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <vector>
+#include <limits>
+#include "tiles.h"
+#include "check.h"
+
+using namespace std;
+/* ----------------------------------------------------------------------------
+'isNaN' is true of NaN only.
+---------------------------------------------------------------------------- */
+static bool isNaN (float v)
+{
+	return v != v;
+}
+/* ----------------------------------------------------------------------------
+'averaging' checks that each entry of a coarser level is the mean of its four
+children that are not NaN, and NaN only when all four are.  The finest level
+is read through the function average() is given; an interrupted averaging
+says so.
+---------------------------------------------------------------------------- */
+static void averaging ()
+{
+	const float nan = numeric_limits<float>::quiet_NaN();
+	TilePyramid p;
+	p.resize(4);
+	CHECK(p.levels() == 3);
+	CHECK(p.values(0) == 0);
+	vector<float> base(12*16, 1.f);
+	float *v = &base[0];
+	atomic<bool> stop(false);
+	auto finest = [&](PixIndex pix) { return v[pix]; };
+/*
+			The first four entries of face 0 are the children of entry 0 of
+			level 1, and so on.
+*/
+	const float kids[4][4] = { { 1.f, 2.f, 3.f, 6.f },
+	                           { nan, 2.f, nan, 4.f },
+	                           { nan, nan, nan, nan },
+	                           { 5.f, nan, nan, nan } };
+	for (int j = 0; j < 4; j++)
+		for (int i = 0; i < 4; i++) v[4*j + i] = kids[j][i];
+	CHECK(p.average(finest, stop));
+	p.build();
+	const float *l1 = p.tile(TileKey(1, 0, 0, 0));
+	CHECK(l1[0] == 3.f);
+	CHECK(l1[1] == 3.f);
+	CHECK(isNaN(l1[2]));
+	CHECK(l1[3] == 5.f);
+	const float *l2 = p.tile(TileKey(2, 0, 0, 0));
+	CHECK(l2[0] == (3.f + 3.f + 5.f) / 3.f);
+	for (int f = 1; f < 12; f++)
+	{
+		CHECK(p.tile(TileKey(1, f, 0, 0))[0] == 1.f);
+		CHECK(p.tile(TileKey(2, f, 0, 0))[0] == 1.f);
+	}
+/*
+			A face all NaN stays NaN to the top.
+*/
+	for (int j = 16; j < 32; j++) v[j] = nan;
+	CHECK(p.average(finest, stop));
+	p.build();
+	CHECK(isNaN(p.tile(TileKey(1, 1, 0, 0))[3]));
+	CHECK(isNaN(p.tile(TileKey(2, 1, 0, 0))[0]));
+	stop = true;
+	CHECK(! p.average(finest, stop));
+}
+/* ----------------------------------------------------------------------------
+'sizes' checks the tile sides and the level chosen for a detail where the
+faces of a 512 map, 512 to 1 values a side, pass the 256 value tile side.
+---------------------------------------------------------------------------- */
+static void sizes ()
+{
+	TilePyramid p;
+	p.resize(512);
+	CHECK(p.levels() == 10);
+	CHECK(p.tileSideAt(0) == TilePyramid::tileSide);
+	CHECK(p.tilesPerSide(0) == 2);
+	CHECK(p.tileSideAt(1) == TilePyramid::tileSide);
+	CHECK(p.tilesPerSide(1) == 1);
+	CHECK(p.tileSideAt(2) == 128);
+	CHECK(p.tilesPerSide(2) == 1);
+	CHECK(p.tileSideAt(9) == 1);
+	CHECK(p.levelFor(512) == 0);
+	CHECK(p.levelFor(513) == 0);
+	CHECK(p.levelFor(257) == 0);
+	CHECK(p.levelFor(256) == 1);
+	CHECK(p.levelFor(255) == 1);
+	CHECK(p.levelFor(129) == 1);
+	CHECK(p.levelFor(128) == 2);
+	CHECK(p.levelFor(1) == 9);
+	CHECK(p.levelFor(0) == 9);
+/*
+			A tile of the finest level is a quarter of its face, in NESTED
+			order, so tile (1, 0) of face 1 starts a quarter into the face.
+			Only the levels above it are kept.
+*/
+	CHECK(p.firstPixel(TileKey(0, 1, 1, 0)) == 512*512 + 256*256);
+	CHECK(p.firstPixel(TileKey(0, 1, 0, 1)) == 512*512 + 2*256*256);
+	CHECK(p.tile(TileKey(1, 2, 0, 0)) == p.values(1) + 2*256*256);
+	CHECK(p.tile(TileKey(2, 3, 0, 0)) == p.values(2) + 3*128*128);
+}
+/* ----------------------------------------------------------------------------
+'eviction' checks that the tile cache evicts the least recently used tile,
+that a look-up makes a tile the most recently used, and that shrinking the
+cache hands back the names of the tiles it evicts.
+---------------------------------------------------------------------------- */
+static void eviction ()
+{
+	TileCache c(3);
+	vector<unsigned int> ev;
+	unsigned int name = 0;
+	c.insert(TileKey(0, 0, 0, 0), 1, ev);
+	c.insert(TileKey(0, 0, 1, 0), 2, ev);
+	c.insert(TileKey(0, 0, 0, 1), 3, ev);
+	CHECK(ev.empty());
+	CHECK(c.size() == 3);
+	CHECK(c.find(TileKey(0, 0, 0, 0), name) && (name == 1));
+	CHECK(! c.find(TileKey(1, 0, 0, 0), name));
+/*
+			Tile 2 is now the least recently used.
+*/
+	c.insert(TileKey(0, 1, 0, 0), 4, ev);
+	CHECK((ev.size() == 1) && (ev[0] == 2));
+	CHECK(! c.find(TileKey(0, 0, 1, 0), name));
+	ev.clear();
+	c.insert(TileKey(0, 2, 0, 0), 5, ev);
+	CHECK((ev.size() == 1) && (ev[0] == 3));
+	CHECK(c.size() == 3);
+/*
+			Most recently used first:  5, 4, 1.
+*/
+	ev.clear();
+	c.setCapacity(1, ev);
+	CHECK(c.capacity() == 1);
+	CHECK((ev.size() == 2) && (ev[0] == 1) && (ev[1] == 4));
+	CHECK(c.size() == 1);
+	CHECK(c.find(TileKey(0, 2, 0, 0), name) && (name == 5));
+/*
+			A tile inserted again takes its new name and hands back the old.
+*/
+	ev.clear();
+	c.insert(TileKey(0, 2, 0, 0), 6, ev);
+	CHECK((ev.size() == 1) && (ev[0] == 5));
+	CHECK(c.find(TileKey(0, 2, 0, 0), name) && (name == 6));
+	ev.clear();
+	c.setCapacity(0, ev);
+	CHECK(c.capacity() == 1);
+	CHECK(ev.empty());
+	c.clear(ev);
+	CHECK((ev.size() == 1) && (ev[0] == 6));
+	CHECK(c.size() == 0);
+}
+int main ()
+{
+	averaging();
+	sizes();
+	eviction();
+	return checkResult("tiles");
+}
@@ -0,0 +1,120 @@
+/* ============================================================================
+'tst_upload.cpp' checks what the sky texture sends to GL, through an uploader
+that records the calls instead of making them:  a repainted texture is sent
+whole, once, at the next flush, and a flush with nothing repainted sends
+nothing.  No GL context is needed; Qt runs on its offscreen platform.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <QApplication>
+#include <QElapsedTimer>
+#include "skytexture.h"
+#include "rangecontrol.h"
+#include "check.h"
+/* ============================================================================
+'Recorder' counts the calls made to send texels and the bytes they send.
+============================================================================ */
+class Recorder : public TexUploader
+{
+public:
+	int calls;
+	long long bytes;
+
+	Recorder () : calls(0), bytes(0) {}
+	void reset () { calls = 0; bytes = 0; }
+	void image (int w, int h, unsigned int, unsigned int, const void *data)
+	{
+		calls++;
+		if (data != 0) bytes += 4LL*w*h;
+	}
+	void subImage (const TexRect &r, int, const uint32_t *)
+	{
+		calls++;
+		bytes += 4*r.area();
+	}
+};
+/* ----------------------------------------------------------------------------
+'pump' runs the event loop for a while, so that the texture's timer ticks.
+
+Arguments:
+	ms - How long, in milliseconds.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+static void pump (int ms)
+{
+	QElapsedTimer t;
+	t.start();
+	while (t.elapsed() < ms)
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+}
+/* ----------------------------------------------------------------------------
+'repaint' paints the texture afresh and lets the timer run down, then checks
+that the next flush sends the whole texture in one call and that the flush
+after it, and one after an idle spell, send nothing.
+
+Arguments:
+	tex   - The texture.
+	map   - The map to paint it from.
+	range - The range control giving the field, range and colors.
+	rec   - The recorder the texture sends through.
+	n     - The number of times the texture was sent since the last
+	        repaint, counted by the caller from 'retextured'.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+static void repaint (SkyTexture &tex, HealpixMap &map, RangeControl &range,
+                     Recorder &rec, int &n)
+{
+	const long long whole = 4LL*(4*map.nside())*(4*map.nside());
+	n = 0;
+	tex.set(&map, &range);
+	tex.wait();
+	pump(300);
+	CHECK(n > 0);
+	rec.reset();
+	tex.flush();
+	CHECK(rec.calls == 1);
+	CHECK(rec.bytes == whole);
+	rec.reset();
+	tex.flush();
+	CHECK(rec.calls == 0);
+	CHECK(rec.bytes == 0);
+	pump(200);
+	tex.flush();
+	CHECK(rec.calls == 0);
+	CHECK(rec.bytes == 0);
+}
+int main (int argc, char *argv[])
+{
+	if (qgetenv("QT_QPA_PLATFORM").isEmpty()) qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+	const unsigned int ns = 8;
+	HealpixMap map(HealpixMap::NSide2NPix(ns), Skymap::TPix, HealpixMap::Nested);
+	for (PixIndex i = 0; i < map.size(); i++)
+		map.setValue(Skymap::TCol, i, double(i % 97));
+	RangeControl range;
+	range.init(&map);
+	Recorder rec;
+	SkyTexture tex;
+	tex.setUploader(&rec);
+	int n = 0;
+	QObject::connect(&tex, &SkyTexture::retextured, [&n] { n++; });
+/*
+			Nothing is sent before the texture is painted.
+*/
+	tex.flush();
+	CHECK(rec.calls == 0);
+	repaint(tex, map, range, rec, n);
+/*
+			A second repaint, of changed values, is sent once too.
+*/
+	for (PixIndex i = 0; i < map.size(); i++)
+		map.setValue(Skymap::TCol, i, double(i % 31));
+	repaint(tex, map, range, rec, n);
+	CHECK(! tex.isTiled());
+	return checkResult("upload");
+}
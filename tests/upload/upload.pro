@@ -0,0 +1,27 @@
+# What the sky texture sends to GL, recorded in place of the GL calls.
+include(../maps.pri)
+TARGET = tst_upload
+HEADERS += $$SRC/skytexture.h \
+           $$SRC/texupload.h
+SOURCES += $$SRC/skytexture.cpp \
+           $$SRC/texupload.cpp \
+           tst_upload.cpp
+unix{
+  isEmpty( INCLUDE_DIR ){
+    INCLUDE_DIR = $$PREFIX/include
+  }
+  INCLUDEPATH *= $$INCLUDE_DIR
+  contains( QT_VERSION, "^4\..*" ){
+    LIBS += -lQGLViewer
+  }
+  contains( QT_VERSION, "^5\..*" ){
+    LIBS += -lQGLViewer-qt5
+  }
+  macx{
+    LIBS *= -lobjc -lQGLViewer
+  }
+}
+win32{
+  DEFINES *= QT_THREAD_SUPPORT
+  LIBS *= libQGLViewer
+}
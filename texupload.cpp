@@ -0,0 +1,49 @@
+/* ============================================================================
+'texupload.cpp' defines the sending of texels to GL.  The classes are
+defined in 'texupload.h'.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <QGLViewer/qglviewer.h>
+#include "texupload.h"
+
+using namespace std;
+/* ============================================================================
+'GLTexUploader' sends texels to GL.
+============================================================================ */
+/* ----------------------------------------------------------------------------
+'image' defines the bound texture with glTexImage2D.
+
+Arguments:
+	w,h    - The size of the texture.
+	format - The format of the data.
+	type   - The type of the data.
+	data   - The texels, or null to leave the texture undefined.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void GLTexUploader::image (int w, int h, unsigned int format, unsigned int type,
+                           const void *data)
+{
+	glTexImage2D(GL_TEXTURE_2D, 0, 4, w, h, 0, format, type, data);
+}
+/* ----------------------------------------------------------------------------
+'subImage' replaces a rectangle of the bound texture with glTexSubImage2D,
+reading the rows of the source 'stride' texels apart.
+
+Arguments:
+	r      - The rectangle.
+	stride - The texels from the start of one source row to the next.
+	rgba   - The first texel of the rectangle, as packed RGBA.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void GLTexUploader::subImage (const TexRect &r, int stride, const uint32_t *rgba)
+{
+	if (stride != r.w) glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, r.x, r.y, r.w, r.h, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	if (stride != r.w) glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
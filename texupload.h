@@ -0,0 +1,46 @@
+#ifndef TEXUPLOAD_H
+#define TEXUPLOAD_H
+/* ============================================================================
+'texupload.h' defines the interface through which the sky texture's texels
+are sent to GL, so that what is sent can be observed without a GL context.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <stddef.h>
+#include <stdint.h>
+/* ============================================================================
+'TexRect' is a rectangle of texels:  columns x to x + w - 1 of rows y to
+y + h - 1.
+============================================================================ */
+struct TexRect
+{
+	int x, y, w, h;
+
+	TexRect (int x0 = 0, int y0 = 0, int w0 = 0, int h0 = 0)
+		: x(x0), y(y0), w(w0), h(h0) {}
+	long long area () const { return (long long)(w) * h; }
+};
+/* ============================================================================
+'TexUploader' sends texels to the texture bound to GL_TEXTURE_2D.  'image'
+defines the whole texture, with any format and type glTexImage2D takes, or
+leaves it undefined if the data is null; 'subImage' replaces a rectangle of
+it with packed RGBA texels read 'stride' texels to a row.  GLTexUploader
+makes the GL calls; another implementation can stand in for it to record
+what would be sent.
+============================================================================ */
+class TexUploader
+{
+public:
+	virtual ~TexUploader () {}
+	virtual void image (int w, int h, unsigned int format, unsigned int type,
+	                    const void *data) = 0;
+	virtual void subImage (const TexRect &r, int stride, const uint32_t *rgba) = 0;
+};
+class GLTexUploader : public TexUploader
+{
+public:
+	void image (int w, int h, unsigned int format, unsigned int type, const void *data);
+	void subImage (const TexRect &r, int stride, const uint32_t *rgba);
+};
+#endif
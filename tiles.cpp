@@ -0,0 +1,223 @@
+/* ============================================================================
+'tiles.cpp' defines the CPU side of the tiled, level-of-detail sky texture:
+the value pyramid and the cache of resident tiles.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <math.h>
+#include <limits>
+#include "tiles.h"
+#include "parallel.h"
+
+using namespace std;
+/* ============================================================================
+'TilePyramid' holds the display values of a map face by face in NESTED order,
+with coarser levels built by averaging.
+============================================================================ */
+/* ----------------------------------------------------------------------------
+'resize' sizes the pyramid for a map, allocating every level but the finest.
+The values are left undefined until average() and build() are called.
+
+Arguments:
+	nside - The map's nside; a power of two.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void TilePyramid::resize (int nside)
+{
+	if (nside == ns) return;
+	clear();
+	ns = nside;
+	for (PixIndex side = ns; side >= 1; side /= 2)
+	{
+		level_.push_back(vector<float>());
+		if (side < ns) level_.back().resize(size_t(12*side*side));
+	}
+}
+/* ----------------------------------------------------------------------------
+'clear' releases all the levels.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void TilePyramid::clear ()
+{
+	level_.clear();
+	ns = 0;
+}
+/* ----------------------------------------------------------------------------
+'build' fills the coarser levels from the first level kept, each entry the
+mean of its four children that are not NaN, or NaN if all four are.  Each
+level is split among a pool of threads.
+
+Arguments:
+	None.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void TilePyramid::build ()
+{
+	const float nan = numeric_limits<float>::quiet_NaN();
+	for (size_t l = 2; l < level_.size(); l++)
+	{
+		const float *fine = &level_[l-1][0];
+		float *coarse = &level_[l][0];
+		parallelFor(PixIndex(level_[l].size()), 16384,
+			[&](unsigned int, PixIndex b, PixIndex e)
+		{
+			for (PixIndex j = b; j < e; j++)
+			{
+				const float *c = fine + 4*j;
+				float sum = 0.f;
+				int n = 0;
+				for (int i = 0; i < 4; i++)
+					if (c[i] == c[i]) { sum += c[i]; n++; }
+				coarse[j] = (n > 0) ? sum / n : nan;
+			}
+		});
+	}
+}
+/* ----------------------------------------------------------------------------
+'levelFor' chooses the level to draw for a given detail.
+
+Arguments:
+	side - The number of values a face side should show.
+
+Returned:
+	The coarsest level whose faces are at least that many values a side, or
+	the finest level if none is.
+---------------------------------------------------------------------------- */
+int TilePyramid::levelFor (int side) const
+{
+	int l = levels() - 1;
+	while (l > 0 && faceSide(l) < side) l--;
+	return (l > 0) ? l : 0;
+}
+/* ----------------------------------------------------------------------------
+'positions' returns the position within a tile of each NESTED entry, x in the
+low 16 bits and y in the high 16 bits.  Entries 0 to n^2 - 1 cover an n x n
+tile for any power of two n up to tileSide, so one table serves every level.
+
+Static function.
+
+Arguments:
+	None.
+
+Returned:
+	The tileSide^2 positions.
+---------------------------------------------------------------------------- */
+const vector<uint32_t> &TilePyramid::positions ()
+{
+	static const vector<uint32_t> xy = [] {
+		vector<uint32_t> t(size_t(tileSide)*tileSide);
+		for (uint32_t j = 0; j < t.size(); j++)
+		{
+			uint32_t x, y;
+			unnest(j, x, y);
+			t[j] = (y << 16) | x;
+		}
+		return t;
+	}();
+	return xy;
+}
+/* ============================================================================
+'TileCache' tracks the tiles resident on the graphics card.
+============================================================================ */
+/* ----------------------------------------------------------------------------
+'setCapacity' sets the most tiles kept resident, evicting the least recently
+used beyond it.
+
+Arguments:
+	n       - The capacity; at least 1.
+	evicted - Receives the names of the evicted tiles.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void TileCache::setCapacity (size_t n, vector<unsigned int> &evicted)
+{
+	cap = (n > 0) ? n : 1;
+	trim(cap, evicted);
+}
+/* ----------------------------------------------------------------------------
+'find' looks up a tile, making it the most recently used if it is resident.
+
+Arguments:
+	k    - The tile.
+	name - Receives its name if it is resident.
+
+Returned:
+	true if the tile is resident.
+---------------------------------------------------------------------------- */
+bool TileCache::find (const TileKey &k, unsigned int &name)
+{
+	map<TileKey, Entries::iterator>::iterator w = where.find(k);
+	if (w == where.end()) return false;
+	lru.splice(lru.begin(), lru, w->second);
+	name = w->second->second;
+	return true;
+}
+/* ----------------------------------------------------------------------------
+'insert' adds a tile as the most recently used, evicting the least recently
+used if the cache is full.  A tile already resident takes the new name, and
+the old one is handed back.
+
+Arguments:
+	k       - The tile.
+	name    - Its name.
+	evicted - Receives the names of the evicted tiles.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void TileCache::insert (const TileKey &k, unsigned int name, vector<unsigned int> &evicted)
+{
+	map<TileKey, Entries::iterator>::iterator w = where.find(k);
+	if (w != where.end())
+	{
+		evicted.push_back(w->second->second);
+		lru.erase(w->second);
+		where.erase(w);
+	}
+	trim(cap - 1, evicted);
+	lru.push_front(make_pair(k, name));
+	where[k] = lru.begin();
+}
+/* ----------------------------------------------------------------------------
+'clear' evicts every tile.
+
+Arguments:
+	evicted - Receives the names of the evicted tiles.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void TileCache::clear (vector<unsigned int> &evicted)
+{
+	trim(0, evicted);
+}
+/* ----------------------------------------------------------------------------
+'trim' evicts the least recently used tiles until at most n remain.
+
+Arguments:
+	n       - The number to keep.
+	evicted - Receives the names of the evicted tiles.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+void TileCache::trim (size_t n, vector<unsigned int> &evicted)
+{
+	while (lru.size() > n)
+	{
+		evicted.push_back(lru.back().second);
+		where.erase(lru.back().first);
+		lru.pop_back();
+	}
+}
@@ -0,0 +1,308 @@
+#ifndef TILES_H
+#define TILES_H
+/* ============================================================================
+'tiles.h' defines the CPU side of the tiled, level-of-detail sky texture used
+for large maps:  a pyramid of display values kept face by face in NESTED
+order and cut into square tiles, a least-recently-used cache of the tiles
+resident on the graphics card, and the interface through which the faces
+draw themselves tile by tile.  None of these touch OpenGL.
+============================================================================ */
+/*
+			Fetch header files.
+*/
+#include <vector>
+#include <list>
+#include <map>
+#include <atomic>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include "pixel.h"
+#include "parallel.h"
+/* ============================================================================
+'TileKey' names one tile:  the pyramid level, the HealPix base face, and the
+tile's column and row within the face.  Columns run along the face's x
+coordinate and the texture's s coordinate; rows along y and t.
+============================================================================ */
+struct TileKey
+{
+	int level, face, tx, ty;
+
+	TileKey (int l = 0, int f = 0, int x = 0, int y = 0)
+		: level(l), face(f), tx(x), ty(y) {}
+	bool operator< (const TileKey &k) const;
+	bool operator== (const TileKey &k) const;
+};
+/* ============================================================================
+'TilePyramid' holds the display values of a map as 12 base faces of
+nside x nside values, each face in NESTED order, with coarser levels built by
+averaging.  In NESTED order the four children of entry j are entries 4j to
+4j + 3, so level l + 1 is level l averaged four to one, and a square block of
+a face is a contiguous run of entries.  Each level is cut into square tiles of
+at most tileSide values a side; a tile is one such run.
+
+The finest level, as large as the map itself, is not kept:  its values are
+read from the map, once to average the level above it and again for each of
+its tiles as it is drawn.  The levels kept are a third of the finest in size.
+
+NaN marks an invalid pixel.  Averages skip NaN and are NaN only if all four
+values are.
+============================================================================ */
+class TilePyramid
+{
+public:
+	static const int tileSide = 256;	//!< Largest tile side, in values
+
+	TilePyramid () : ns(0) {}
+	void resize (int nside);
+	void clear ();
+	bool empty () const { return ns == 0; }
+
+	// The first level kept, averaged from the finest or filled by the
+	// caller, and the averaging of the coarser levels.
+	template <class V> bool average (V value, const std::atomic<bool> &stop);
+	float *values (int level) { return (level > 0) ? &level_[level][0] : 0; }
+	void build ();
+
+	// Sizes.
+	int nside () const { return ns; }
+	int levels () const { return int(level_.size()); }
+	int faceSide (int level) const { return ns >> level; }
+	int tileSideAt (int level) const;
+	int tilesPerSide (int level) const { return faceSide(level) / tileSideAt(level); }
+	int levelFor (int side) const;
+
+	// The first pixel of a tile, the values of a tile of a level kept, and
+	// a tile's values colored into a row-major image.
+	PixIndex firstPixel (const TileKey &k) const;
+	const float *tile (const TileKey &k) const;
+	template <class F> void paintTile (const TileKey &k, F color, uint32_t *out) const;
+	template <class F> static void paintValues (const float *v, int ts, F color,
+	                                            uint32_t *out);
+
+	// NESTED index within a square block from x, y and back.
+	static uint64_t nest (uint32_t x, uint32_t y);
+	static void unnest (uint64_t p, uint32_t &x, uint32_t &y);
+protected:
+	int ns;					//!< nside of the finest level
+	std::vector<std::vector<float> > level_;	//!< Values of each level; none of 0
+
+	static const std::vector<uint32_t> &positions ();
+	static uint64_t spread (uint32_t v);
+	static uint32_t compact (uint64_t b);
+};
+/* ============================================================================
+'TileCache' tracks which tiles are resident on the graphics card, each with
+an integer name (a GL texture), evicting the least recently used when full.
+The caller frees the names handed back.
+============================================================================ */
+class TileCache
+{
+public:
+	TileCache (size_t capacity = 512) : cap(capacity) {}
+	void setCapacity (size_t n, std::vector<unsigned int> &evicted);
+	size_t capacity () const { return cap; }
+	size_t size () const { return lru.size(); }
+
+	bool find (const TileKey &k, unsigned int &name);
+	void insert (const TileKey &k, unsigned int name,
+	             std::vector<unsigned int> &evicted);
+	void clear (std::vector<unsigned int> &evicted);
+protected:
+	typedef std::list<std::pair<TileKey, unsigned int> > Entries;
+	size_t cap;					//!< Most tiles resident
+	Entries lru;				//!< Resident tiles, most recently used first
+	std::map<TileKey, Entries::iterator> where;	//!< Each tile's entry in 'lru'
+	void trim (size_t n, std::vector<unsigned int> &evicted);
+};
+/* ============================================================================
+'TileBinder' is what a face asks, when drawn from a tiled texture, how many
+tiles a side the face is cut into, whether a point of the sky is seen, and to
+make a tile the current texture.
+============================================================================ */
+class TileBinder
+{
+public:
+	virtual ~TileBinder () {}
+	virtual int tilesPerSide () const = 0;
+	virtual bool facing (float x, float y, float z) const = 0;
+	virtual bool bindTile (int face, int tx, int ty) = 0;
+};
+/* ----------------------------------------------------------------------------
+'operator<' orders tile keys, for use as a map key.
+
+Arguments:
+	k - The other key.
+
+Returned:
+	true if this key comes first.
+---------------------------------------------------------------------------- */
+inline bool TileKey::operator< (const TileKey &k) const
+{
+	if (level != k.level) return level < k.level;
+	if (face  != k.face)  return face  < k.face;
+	if (ty    != k.ty)    return ty    < k.ty;
+	return tx < k.tx;
+}
+inline bool TileKey::operator== (const TileKey &k) const
+{
+	return (level == k.level) && (face == k.face) && (tx == k.tx) && (ty == k.ty);
+}
+/* ----------------------------------------------------------------------------
+'tileSideAt' returns the side of the tiles of a level.
+
+Arguments:
+	level - The level; 0 is the finest.
+
+Returned:
+	The side, in values:  tileSide, or the face side if that is smaller.
+---------------------------------------------------------------------------- */
+inline int TilePyramid::tileSideAt (int level) const
+{
+	int side = faceSide(level);
+	return (side < tileSide) ? side : tileSide;
+}
+/* ----------------------------------------------------------------------------
+'nest' interleaves the bits of x and y into a NESTED index, x taking the even
+bits and y the odd ones, as 'xy2pix' does.  'unnest' splits them apart again.
+Each spreads or compacts the bits of a coordinate in five shift-and-mask steps.
+
+Static function.
+
+Arguments:
+	x,y - The position within a square block.
+
+Returned:
+	The NESTED index within the block.
+---------------------------------------------------------------------------- */
+inline uint64_t TilePyramid::nest (uint32_t x, uint32_t y)
+{
+	return spread(x) | (spread(y) << 1);
+}
+inline void TilePyramid::unnest (uint64_t p, uint32_t &x, uint32_t &y)
+{
+	x = compact(p);
+	y = compact(p >> 1);
+}
+inline uint64_t TilePyramid::spread (uint32_t v)
+{
+	uint64_t b = v;
+	b = (b | (b << 16)) & 0x0000ffff0000ffffULL;
+	b = (b | (b <<  8)) & 0x00ff00ff00ff00ffULL;
+	b = (b | (b <<  4)) & 0x0f0f0f0f0f0f0f0fULL;
+	b = (b | (b <<  2)) & 0x3333333333333333ULL;
+	b = (b | (b <<  1)) & 0x5555555555555555ULL;
+	return b;
+}
+inline uint32_t TilePyramid::compact (uint64_t b)
+{
+	b &= 0x5555555555555555ULL;
+	b = (b | (b >>  1)) & 0x3333333333333333ULL;
+	b = (b | (b >>  2)) & 0x0f0f0f0f0f0f0f0fULL;
+	b = (b | (b >>  4)) & 0x00ff00ff00ff00ffULL;
+	b = (b | (b >>  8)) & 0x0000ffff0000ffffULL;
+	b = (b | (b >> 16)) & 0x00000000ffffffffULL;
+	return uint32_t(b);
+}
+/* ----------------------------------------------------------------------------
+'average' fills the first level kept, each entry the mean of its four
+children of the finest level that are not NaN, or NaN if all four are.  The
+level is split among a pool of threads, which watch 'stop' between blocks of
+entries and all give up once it is set.
+
+Arguments:
+	value - The value of a pixel of the finest level, called as value(pix)
+	        with its NESTED number; NaN if it is invalid.
+	stop  - Set to interrupt the averaging.
+
+Returned:
+	true if the level was completed, false if it was interrupted.
+---------------------------------------------------------------------------- */
+template <class V>
+bool TilePyramid::average (V value, const std::atomic<bool> &stop)
+{
+	const PixIndex block = 1 << 14;
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	if (levels() < 2) return true;
+	float *coarse = &level_[1][0];
+	parallelFor(PixIndex(level_[1].size()), block,
+		[&](unsigned int, PixIndex b, PixIndex e)
+	{
+		for (PixIndex j0 = b; j0 < e; j0 += block)
+		{
+			if (stop.load(std::memory_order_relaxed)) return;
+			PixIndex j1 = (j0 + block < e) ? j0 + block : e;
+			for (PixIndex j = j0; j < j1; j++)
+			{
+				float sum = 0.f;
+				int n = 0;
+				for (PixIndex i = 4*j; i < 4*j + 4; i++)
+				{
+					float c = value(i);
+					if (c == c) { sum += c; n++; }
+				}
+				coarse[j] = (n > 0) ? sum / n : nan;
+			}
+		}
+	});
+	return ! stop;
+}
+/* ----------------------------------------------------------------------------
+'firstPixel' returns the NESTED number, at the tile's level, of the first
+value of a tile; the tile's values are that pixel and those that follow it.
+
+Arguments:
+	k - The tile.
+
+Returned:
+	The pixel number.
+---------------------------------------------------------------------------- */
+inline PixIndex TilePyramid::firstPixel (const TileKey &k) const
+{
+	const PixIndex side = faceSide(k.level);
+	const PixIndex ts   = tileSideAt(k.level);
+	return k.face*side*side + PixIndex(nest(k.tx, k.ty))*ts*ts;
+}
+/* ----------------------------------------------------------------------------
+'tile' returns the values of a tile of a level kept, 1 or coarser.
+
+Arguments:
+	k - The tile.
+
+Returned:
+	The tileSideAt(k.level)^2 values, in NESTED order within the tile.
+---------------------------------------------------------------------------- */
+inline const float *TilePyramid::tile (const TileKey &k) const
+{
+	return &level_[k.level][firstPixel(k)];
+}
+/* ----------------------------------------------------------------------------
+'paintTile' colors a tile of a level kept into a row-major image, row y
+holding the values of y within the tile.  'paintValues' colors the values of
+any tile, in NESTED order, the same way; it serves the finest level, whose
+values the caller reads from the map.
+
+Arguments:
+	k     - The tile.
+	v     - The tile's values.
+	ts    - The tile's side.
+	color - The coloring, called as color(v) for each value and returning
+	        the texel.
+	out   - The tileSideAt(k.level)^2 texels.
+
+Returned:
+	Nothing.
+---------------------------------------------------------------------------- */
+template <class F>
+inline void TilePyramid::paintTile (const TileKey &k, F color, uint32_t *out) const
+{
+	paintValues(tile(k), tileSideAt(k.level), color, out);
+}
+template <class F>
+inline void TilePyramid::paintValues (const float *v, int ts, F color, uint32_t *out)
+{
+	const uint32_t *xy = &positions()[0];
+	for (uint32_t j = 0; j < uint32_t(ts)*ts; j++)
+		out[(xy[j] >> 16)*ts + (xy[j] & 0xffff)] = color(v[j]);
+}
+#endif